@@ -2,33 +2,94 @@
 #include<fstream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <queue>
+#include <cmath>        // For pow, fabs in the volume-delay functions
+#include <memory>       // For unique_ptr, make_unique
 #include <limits>       // For numeric_limits
 #include <algorithm>    // For max, reverse, remove_if
-#include <ctime>        // For time(), srand()
-#include <cstdlib>      // For rand(), srand(), system()
+#include <ctime>        // For time()
+#include <cstdlib>      // For system(), atoi()
 #include <cstdio>       // Potentially for system(), though <cstdlib> is more common for it
 #include <iomanip>      // For fixed, setprecision
 #include <sstream>      // For stringstream
 #include <thread>       // For std::thread
 #include <chrono>       // For std::chrono (used by std::this_thread::sleep_for and high_resolution_clock)
+#include <mutex>        // For std::mutex guarding cross-thread hand-offs
+#include <condition_variable>
+#include <atomic>
+#include <new>          // For bad_alloc in the test allocation counter
+#include <random>       // For mt19937 in synthetic benchmark maps
+#include <deque>
+#include <tuple>        // For lexicographic label keys in multi-criteria routing
+#include <set>
+#include <functional>
+#include <cstring>      // For memcpy
+#include <cstdint>      // For fixed-width history sample fields
 
 #ifdef _WIN32
 #include <windows.h> // For Sleep(), Beep(), SetConsoleOutputCP()
 #else
 #include <unistd.h> // For sleep()
+#include <cerrno>
+#include <fcntl.h>      // For open() on feed files and named pipes
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>     // For Unix domain sockets
+#include <sys/resource.h> // For raising the open-file limit in server mode
+#include <sys/wait.h>     // For reaping shard worker processes
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>    // Event loop of the routing query server
+#include <sys/eventfd.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_SIMD // Batch sweep kernels for AVX2 and SSE4.1, picked at run time
+#include <immintrin.h>
 #endif
 
 using namespace std;
 
+#ifdef TESTING
+// Counts the calling thread's heap allocations so the tests can check that steady-state route
+// queries do not allocate, whatever the weather and playback threads are doing meanwhile
+thread_local size_t testAllocations = 0;
+#ifdef __GNUC__
+__attribute__((noinline)) // Inlined malloc/free pairs trip GCC's -Wmismatched-new-delete
+#endif
+void* operator new(size_t size) {
+    ++testAllocations;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); } // Sized partner, so -Wsized-deallocation stays quiet
+#endif
+
 // ================ GLOBAL CONSTANTS ================
 constexpr int MAX_CONGESTION = 5;
 constexpr int WEATHER_UPDATE_INTERVAL = 30; // Seconds before weather updates
 constexpr double EMERGENCY_SPEED_BOOST = 1.5;
+constexpr int ASSIGNMENT_MAX_ITERATIONS = 50;   // Frank-Wolfe iteration cap
+constexpr double ASSIGNMENT_GAP_TOLERANCE = 1e-4; // Relative gap at which we call it equilibrium
+constexpr int HISTORY_CAPACITY = 64;          // Recent observations kept per road segment
+constexpr int HISTORY_BUCKET_WINDOW = 50;     // Effective sample window of each time-of-day bucket
+constexpr double HISTORY_EWMA_ALPHA = 0.2;    // Weight of the newest observation in the EWMA
+constexpr double FORECAST_DECAY_MINUTES = 30; // How fast today's deviation fades back to the daily profile
+constexpr size_t FEED_BATCH_LIMIT = 4096;     // Feed events applied per batch
+constexpr int ROUTE_UNREACHABLE = numeric_limits<int>::max(); // Travel time of a road or node that cannot be used/reached
 
 // ================ GLOBAL SETTINGS ================
-int timeMultiplier = 1; // For time travel feature
+atomic<int> timeMultiplier{1}; // For time travel feature (0 pauses trip playback); read by background threads
 
 // ================ COLOR CODES ================
 // ANSI escape codes. These should work on most modern terminals, including VS Code's integrated terminal.
@@ -49,7 +110,7 @@ const string EMERGENCY_COLOR = "\033[1;91m"; // Bright Red for emergency alerts
 
 // ================ UTILITY FUNCTIONS ================
 void sleep_seconds(int seconds) {
-    seconds = max(1, seconds / max(1, timeMultiplier));
+    seconds = max(1, seconds / max(1, timeMultiplier.load()));
 #ifdef _WIN32
     Sleep(seconds * 1000); // Sleep takes milliseconds on Windows
 #else
@@ -57,25 +118,167 @@ void sleep_seconds(int seconds) {
 #endif
 }
 
-void progressBar(int duration) {
+// Text of a 20-step progress bar, e.g. "[=====>              ] 25%"
+string progressBar(int percent) {
     const int totalTicks = 20;
-    for (int i = 0; i <= totalTicks; ++i) {
-        int percent = (i * 100) / totalTicks;
-        cout << "\r" << YELLOW << "["; // Use \r to move cursor to start of line
-        for (int j = 0; j < totalTicks; ++j) {
-            if (j < i) cout << "=";
-            else if (j == i) cout << ">";
-            else cout << " ";
+    int filled = min(totalTicks, max(0, percent) * totalTicks / 100);
+    string bar = "[";
+    for (int j = 0; j < totalTicks; ++j) {
+        if (j < filled) bar += "=";
+        else if (j == filled) bar += ">";
+        else bar += " ";
+    }
+    return bar + "] " + to_string(percent) + "%";
+}
+
+// Fields of a line in the '|'-separated text protocols (query server, shard workers)
+vector<string> splitFields(const string& text, char separator) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find(separator, start);
+        fields.push_back(text.substr(start, end == string::npos ? string::npos : end - start));
+        if (end == string::npos) return fields;
+        start = end + 1;
+    }
+}
+
+// ================ RANDOM NUMBERS ================
+// SplitMix64: expands one seed into well-mixed 64-bit values; used to seed Xoshiro256 and to
+// derive independent per-run seeds from a master seed.
+struct SplitMix64 {
+    uint64_t state;
+
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+// xoshiro256**: fast generator for simulation randomness. Not thread-safe; every thread or
+// Monte Carlo run owns its instance.
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed) {
+        SplitMix64 mix(seed);
+        for (uint64_t& word : s) word = mix.next();
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, n), n > 0 (multiply-shift instead of modulo)
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Seed of the interactive simulation's random streams (set once in main).
+atomic<uint64_t> simulationSeed{0x5EED};
+
+// Fixed stream ids of the menu and weather threads. Any other thread gets an id from
+// FIRST_SPARE_STREAM up in order of first use.
+enum RandomStream { MENU_STREAM = 0, WEATHER_STREAM = 1, FIRST_SPARE_STREAM = 16 };
+thread_local int randomStreamId = -1;
+
+// Names the calling thread's stream; must run before its first simulationRng().
+void useRandomStream(RandomStream stream) { randomStreamId = stream; }
+
+// The calling thread's random stream for weather, incidents, rush hour and AI figures. With a
+// fixed simulationSeed (--seed) the menu and weather threads draw the same numbers every run;
+// what those draws mean still depends on when the weather thread wakes relative to user input.
+Xoshiro256& simulationRng() {
+    static atomic<uint64_t> spareStreams{FIRST_SPARE_STREAM};
+    thread_local Xoshiro256 rng(simulationSeed.load() + 0x9E3779B97F4A7C15ULL *
+                                (randomStreamId >= 0 ? static_cast<uint64_t>(randomStreamId) : spareStreams++));
+    return rng;
+}
+
+// ================ ROAD TYPE REGISTRY ================
+// Road types get small integer ids so vehicle permission checks are a bit test. The built-in
+// types have fixed ids (their index below); types entered by the user are appended on first use.
+// Vehicles and edges are built on worker threads too, so the user-type list is locked.
+constexpr const char* BUILTIN_ROAD_TYPES[] = {"General", "Bike Lane", "Bus Lane", "Emergency", "Highway", "Bridge", "Tunnel"};
+constexpr size_t BUILTIN_ROAD_TYPE_COUNT = sizeof(BUILTIN_ROAD_TYPES) / sizeof(BUILTIN_ROAD_TYPES[0]);
+
+int roadTypeId(const string& roadType) {
+    for (size_t i = 0; i < BUILTIN_ROAD_TYPE_COUNT; ++i) if (roadType == BUILTIN_ROAD_TYPES[i]) return static_cast<int>(i);
+    static mutex registryMutex;
+    static vector<string> userTypes; // Ids from BUILTIN_ROAD_TYPE_COUNT on
+    lock_guard<mutex> lock(registryMutex);
+    for (size_t i = 0; i < userTypes.size(); ++i) if (userTypes[i] == roadType) return static_cast<int>(BUILTIN_ROAD_TYPE_COUNT + i);
+    userTypes.push_back(roadType);
+    return static_cast<int>(BUILTIN_ROAD_TYPE_COUNT + userTypes.size() - 1);
+}
+
+// Permission bit of a road type id. Ids past 62 share the top bit, so they can only be told
+// apart by vehicles allowed on "All" roads.
+constexpr uint64_t roadTypeBit(int id) { return 1ULL << (id < 63 ? id : 63); }
+
+// Compile-time equivalent of parsing a comma-separated allowed-roads list against the built-in ids.
+constexpr bool nameEquals(const char* text, size_t length, const char* name) {
+    for (size_t i = 0; i < length; ++i) if (name[i] == 0 || name[i] != text[i]) return false;
+    return name[length] == 0;
+}
+
+constexpr uint64_t roadMaskOf(const char* allowedRoads) {
+    uint64_t mask = 0;
+    for (size_t start = 0, i = 0;; ++i) {
+        if (allowedRoads[i] != ',' && allowedRoads[i] != 0) continue;
+        if (nameEquals(allowedRoads + start, i - start, "All")) mask = ~0ULL;
+        for (size_t t = 0; t < BUILTIN_ROAD_TYPE_COUNT; ++t) {
+            if (nameEquals(allowedRoads + start, i - start, BUILTIN_ROAD_TYPES[t])) mask |= roadTypeBit(static_cast<int>(t));
         }
-        cout << "] " << percent << "% " << RESET << flush; // flush ensures immediate output
-        sleep_seconds(duration / totalTicks); // Use the modified sleep_seconds with timeMultiplier
+        if (allowedRoads[i] == 0) return mask;
+        start = i + 1;
     }
-    cout << "\r" << string(30, ' ') << "\r"; // Clear the progress bar line by overwriting with spaces
 }
 
 // ================ ENHANCED VEHICLE SYSTEM ================
 enum VehicleType { CAR, BIKE, BUS, AMBULANCE, POLICE, FIRE_TRUCK };
 
+// Stock vehicle table, indexed by VehicleType. Vehicle objects and the compile-time routing
+// policies are both built from it.
+struct VehicleSpec {
+    const char* name;
+    double speedMultiplier;
+    double fuelRate;
+    const char* emoji;
+    const char* allowedRoads; // Comma-separated string of allowed road types
+};
+
+constexpr VehicleSpec VEHICLE_SPECS[] = {
+    {"Car",        1.0, 0.7, "🚗", "General,Highway,Bridge,Tunnel"},
+    {"Bike",       1.2, 0.3, "🏍️", "General,Bike Lane,Highway,Bridge,Tunnel"},
+    {"Bus",        0.7, 1.5, "🚌", "General,Bus Lane,Highway,Bridge,Tunnel"},
+    {"Ambulance",  1.0, 1.0, "🚑", "General,Emergency,Highway,Bridge,Tunnel"}, // Base speed, emergency boosts
+    {"Police",     1.0, 1.1, "🚓", "General,Emergency,Highway,Bridge,Tunnel"}, // Base speed, emergency boosts
+    {"Fire Truck", 1.0, 1.8, "🚒", "General,Emergency,Highway,Bridge,Tunnel"}, // Base speed, emergency boosts
+};
+
+constexpr double stockSpeed(VehicleType type, bool emergency) {
+    return emergency ? VEHICLE_SPECS[type].speedMultiplier * EMERGENCY_SPEED_BOOST : VEHICLE_SPECS[type].speedMultiplier;
+}
+
+static_assert(roadMaskOf(VEHICLE_SPECS[CAR].allowedRoads) == (roadTypeBit(0) | roadTypeBit(4) | roadTypeBit(5) | roadTypeBit(6)),
+              "Car permissions must fold to General/Highway/Bridge/Tunnel at compile time");
+
 struct Vehicle {
     VehicleType type;
     string name;
@@ -84,29 +287,23 @@ struct Vehicle {
     bool emergency;
     string emoji;
     string allowedRoads; // Comma-separated string of allowed road types
+    bool allRoads;       // allowedRoads contains "All"
+    uint64_t roadMask;   // roadTypeBit() of every allowed road type (parsed once from allowedRoads)
 
     Vehicle(VehicleType t, bool emerg = false) : type(t), emergency(emerg) {
-        switch (t) {
-            case CAR:
-                name = "Car"; speedMultiplier = 1.0; fuelRate = 0.7;
-                emoji = "🚗"; allowedRoads = "General,Highway,Bridge,Tunnel"; break;
-            case BIKE:
-                name = "Bike"; speedMultiplier = 1.2; fuelRate = 0.3;
-                emoji = "🏍️"; allowedRoads = "General,Bike Lane,Highway,Bridge,Tunnel"; break;
-            case BUS:
-                name = "Bus"; speedMultiplier = 0.7; fuelRate = 1.5;
-                emoji = "🚌"; allowedRoads = "General,Bus Lane,Highway,Bridge,Tunnel"; break;
-            case AMBULANCE:
-                name = "Ambulance"; speedMultiplier = 1.0; fuelRate = 1.0; // Base speed, emergency boosts
-                emoji = "🚑"; allowedRoads = "General,Emergency,Highway,Bridge,Tunnel"; break;
-            case POLICE:
-                name = "Police"; speedMultiplier = 1.0; fuelRate = 1.1; // Base speed, emergency boosts
-                emoji = "🚓"; allowedRoads = "General,Emergency,Highway,Bridge,Tunnel"; break;
-            case FIRE_TRUCK:
-                name = "Fire Truck"; speedMultiplier = 1.0; fuelRate = 1.8; // Base speed, emergency boosts
-                emoji = "🚒"; allowedRoads = "General,Emergency,Highway,Bridge,Tunnel"; break;
-        }
+        const VehicleSpec& spec = VEHICLE_SPECS[t];
+        name = spec.name;
+        speedMultiplier = spec.speedMultiplier;
+        fuelRate = spec.fuelRate;
+        emoji = spec.emoji;
+        allowedRoads = spec.allowedRoads;
         if (emergency) speedMultiplier *= EMERGENCY_SPEED_BOOST; // Emergency speed boost
+
+        allRoads = allowedRoads.find("All") != string::npos;
+        roadMask = allRoads ? ~0ULL : 0;
+        stringstream ss(allowedRoads);
+        string allowed;
+        while (getline(ss, allowed, ',')) roadMask |= roadTypeBit(roadTypeId(allowed));
     }
 
     void toggleEmergency() {
@@ -134,11 +331,71 @@ struct Vehicle {
         }
         return false;
     }
+
+    // Same as canUseRoad, for a road type id from roadTypeId(); allocation-free.
+    bool canUseRoadType(int id) const {
+        return (roadMask & roadTypeBit(id)) != 0;
+    }
+};
+
+// Vehicle names used by the text protocols: car, bike, bus, ambulance, police or fire, with a
+// trailing '!' for emergency mode.
+bool parseVehicleName(const string& text, VehicleType& type, bool& emergency) {
+    static const map<string, VehicleType> names = {
+        {"car", CAR}, {"bike", BIKE}, {"bus", BUS}, {"ambulance", AMBULANCE}, {"police", POLICE}, {"fire", FIRE_TRUCK}};
+    emergency = !text.empty() && text.back() == '!';
+    auto it = names.find(emergency ? text.substr(0, text.size() - 1) : text);
+    if (it == names.end()) return false;
+    type = it->second;
+    return true;
+}
+
+// ================ ROUTING POLICIES ================
+// Cost/permission policies for the route search kernel. A stock vehicle's policy is a type
+// whose road mask and speed are compile-time constants, so each kernel instantiation has them
+// folded in; RuntimeVehiclePolicy covers vehicles whose attributes were changed at run time.
+template <VehicleType Type, bool Emergency>
+struct VehiclePolicy {
+    static constexpr uint64_t roadMask() { return roadMaskOf(VEHICLE_SPECS[Type].allowedRoads); }
+    static constexpr double speed() { return stockSpeed(Type, Emergency); }
+
+    // Shared stock Vehicle for display purposes (name, emoji, eco stats)
+    static const Vehicle& vehicle() {
+        static const Vehicle stock(Type, Emergency);
+        return stock;
+    }
+};
+
+struct RuntimeVehiclePolicy {
+    uint64_t mask;
+    double speedMultiplier;
+
+    explicit RuntimeVehiclePolicy(const Vehicle& vehicle) : mask(vehicle.roadMask), speedMultiplier(vehicle.speedMultiplier) {}
+    uint64_t roadMask() const { return mask; }
+    double speed() const { return speedMultiplier; }
 };
 
+// Calls fn(policy) with the compile-time policy of a stock vehicle, or with a RuntimeVehiclePolicy
+// when the vehicle's speed or permissions differ from its stock type.
+template <class Fn>
+int withVehiclePolicy(const Vehicle& vehicle, Fn&& fn) {
+    if (vehicle.roadMask == roadMaskOf(VEHICLE_SPECS[vehicle.type].allowedRoads)
+        && vehicle.speedMultiplier == stockSpeed(vehicle.type, vehicle.emergency)) {
+        switch (vehicle.type) {
+            case CAR:        return vehicle.emergency ? fn(VehiclePolicy<CAR, true>()) : fn(VehiclePolicy<CAR, false>());
+            case BIKE:       return vehicle.emergency ? fn(VehiclePolicy<BIKE, true>()) : fn(VehiclePolicy<BIKE, false>());
+            case BUS:        return vehicle.emergency ? fn(VehiclePolicy<BUS, true>()) : fn(VehiclePolicy<BUS, false>());
+            case AMBULANCE:  return vehicle.emergency ? fn(VehiclePolicy<AMBULANCE, true>()) : fn(VehiclePolicy<AMBULANCE, false>());
+            case POLICE:     return vehicle.emergency ? fn(VehiclePolicy<POLICE, true>()) : fn(VehiclePolicy<POLICE, false>());
+            case FIRE_TRUCK: return vehicle.emergency ? fn(VehiclePolicy<FIRE_TRUCK, true>()) : fn(VehiclePolicy<FIRE_TRUCK, false>());
+        }
+    }
+    return fn(RuntimeVehiclePolicy(vehicle));
+}
+
 // ================ WEATHER SYSTEM ================
 enum WeatherType { SUNNY, RAIN, SNOW, FOG, STORM };
-WeatherType currentWeather = SUNNY;
+atomic<WeatherType> currentWeather{SUNNY}; // Written by the weather thread, read by the simulation
 
 string getWeatherMessage() {
     switch(currentWeather) {
@@ -151,8 +408,8 @@ string getWeatherMessage() {
     }
 }
 
-double getWeatherMultiplier() {
-    switch(currentWeather) {
+double getWeatherMultiplier(WeatherType weather = currentWeather) {
+    switch(weather) {
         case SUNNY: return 1.0;
         case RAIN: return 0.85;
         case SNOW: return 0.7;
@@ -163,13 +420,13 @@ double getWeatherMultiplier() {
 }
 
 void updateWeather() {
-    currentWeather = static_cast<WeatherType>(rand() % 5); // Randomly pick one of 5 weather types
+    currentWeather = static_cast<WeatherType>(simulationRng().below(5)); // Randomly pick one of 5 weather types
     cout << YELLOW << "\n[WEATHER UPDATE] " << getWeatherMessage() << RESET << endl;
 }
 
 // ================ INCIDENT SYSTEM (Singleton Pattern) ================
 class IncidentMonitor {
-private:
+public:
     struct Incident {
         string location;
         string type;
@@ -177,11 +434,31 @@ private:
         time_t timestamp;
         string roadType; // Road type affected by the incident
     };
+
+private:
     vector<Incident> incidents;
+    // Road types affected at each location, so routing can test an edge with a hash lookup
+    // instead of scanning every incident
+    unordered_map<string, vector<string>> locationIndex;
+    uint64_t changeCount = 0; // Bumped whenever the set of incidents changes
 
     // Private constructor to prevent direct instantiation
     IncidentMonitor() {} 
 
+    void indexIncident(const Incident& incident) {
+        locationIndex[incident.location].push_back(incident.roadType);
+    }
+
+    void rebuildIndex() {
+        locationIndex.clear();
+        for (const auto& incident : incidents) indexIncident(incident);
+        ++changeCount;
+    }
+
+    static bool affectsRoadType(const string& incidentRoadType, const string& roadType) {
+        return incidentRoadType == roadType || incidentRoadType == "All" || roadType.find(incidentRoadType) != string::npos;
+    }
+
 public:
     // Static method to get the single instance of the class
     static IncidentMonitor& getInstance() {
@@ -193,27 +470,60 @@ public:
     IncidentMonitor(const IncidentMonitor&) = delete;
     IncidentMonitor& operator=(const IncidentMonitor&) = delete;
 
-    void generateIncident() {
-        if (rand() % 3 == 0) { // Increased chance for incidents (1 in 3)
+    // Returns true when a new incident was raised (available through latestIncident()).
+    bool generateIncident() {
+        Xoshiro256& rng = simulationRng();
+        if (rng.below(3) == 0) { // Increased chance for incidents (1 in 3)
             vector<string> locations = {"Main St", "Highway 1", "Downtown", "Central Bridge", "Suburban Tunnel", "Industrial Zone"};
             vector<string> types = {"🚧 Construction", "🚨 Accident", "💡 Smart Light Outage", "🔧 Roadwork", "🚇 Metro Delay", "💧 Flooding"};
             vector<string> roadTypes = {"General", "Bike Lane", "Bus Lane", "Emergency", "Highway", "Bridge", "Tunnel"}; // Specific road types
 
             Incident newIncident;
-            newIncident.location = locations[rand()%locations.size()];
-            newIncident.type = types[rand()%types.size()];
-            newIncident.severity = rand()%3+1; // Severity 1-3
+            newIncident.location = locations[rng.below(locations.size())];
+            newIncident.type = types[rng.below(types.size())];
+            newIncident.severity = rng.below(3) + 1; // Severity 1-3
             newIncident.timestamp = time(nullptr);
-            newIncident.roadType = roadTypes[rand()%roadTypes.size()]; // Incident affects a specific road type
+            newIncident.roadType = roadTypes[rng.below(roadTypes.size())]; // Incident affects a specific road type
 
             incidents.push_back(newIncident);
+            indexIncident(newIncident);
+            ++changeCount;
             cout << EMERGENCY_COLOR << "\n[ALERT] " << newIncident.type << " at "
                  << newIncident.location << " (Severity: "
                  << string(newIncident.severity, '!') << ") affecting "
                  << newIncident.roadType << " roads.\n" << RESET;
+            return true;
+        }
+        return false;
+    }
+
+    const Incident& latestIncident() const { return incidents.back(); }
+
+    // Adds a batch of externally reported incidents (e.g. from a city feed) without alerts.
+    void addIncidents(const vector<Incident>& batch) {
+        if (batch.empty()) return;
+        for (const auto& incident : batch) {
+            incidents.push_back(incident);
+            indexIncident(incident);
+        }
+        ++changeCount;
+    }
+
+    // True when an active incident at 'from', 'to' or the area 'fromArea' affects this road type.
+    bool blocksRoad(const string& from, const string& to, const string& fromArea, const string& roadType) const {
+        if (locationIndex.empty()) return false;
+        for (const string* location : {&to, &from, &fromArea}) {
+            auto it = locationIndex.find(*location);
+            if (it == locationIndex.end()) continue;
+            for (const string& affected : it->second) {
+                if (affectsRoadType(affected, roadType)) return true;
+            }
         }
+        return false;
     }
 
+    uint64_t version() const { return changeCount; }
+
     void showActiveIncidents() {
         cout << MAGENTA << "\n=== ACTIVE INCIDENTS ===\n" << RESET;
         if (incidents.empty()) {
@@ -226,6 +536,7 @@ public:
                       [](const Incident& i){ return difftime(time(nullptr), i.timestamp) > 300; }), // Remove incidents older than 5 minutes (300 seconds)
             incidents.end()
         );
+        rebuildIndex();
 
         for (const auto& incident : incidents) { // Use const reference for efficiency
             cout << incident.type << " at " << BOLD << incident.location << RESET << " ("
@@ -238,751 +549,5980 @@ public:
     vector<Incident> getIncidents() const { return incidents; }
 };
 
+// ================ TRAFFIC HISTORY ================
+// Bounded per-road history: a ring buffer of recent observations plus running statistics
+// (EWMA and one running mean per hour of the day). Every update is O(1) and the memory
+// footprint is fixed, so it can be fed from every simulation tick.
+class EdgeHistory {
+public:
+    struct Observation {
+        uint32_t timestamp;  // Seconds since epoch
+        float travelTime;    // Seconds to traverse the road
+        uint8_t congestion;  // 0-MAX_CONGESTION
+    };
+
+    struct Forecast {
+        double travelTime;
+        double congestion;
+    };
+
+    EdgeHistory() : head(0), count(0), ewmaTravelTime(0), ewmaCongestion(0) {}
+
+    void record(time_t when, int hourOfDay, double travelTime, int congestion) {
+        ring[head] = {static_cast<uint32_t>(when), static_cast<float>(travelTime), static_cast<uint8_t>(congestion)};
+        head = (head + 1) % HISTORY_CAPACITY;
+        if (count == 0) { // First sample seeds the averages
+            ewmaTravelTime = travelTime;
+            ewmaCongestion = congestion;
+        } else {
+            ewmaTravelTime += HISTORY_EWMA_ALPHA * (travelTime - ewmaTravelTime);
+            ewmaCongestion += HISTORY_EWMA_ALPHA * (congestion - ewmaCongestion);
+        }
+        if (count < HISTORY_CAPACITY) ++count;
+
+        // Running mean over a capped window so old days fade out instead of freezing the profile
+        Bucket& bucket = hourly[hourOfDay];
+        if (bucket.samples < HISTORY_BUCKET_WINDOW) ++bucket.samples;
+        bucket.travelTime += static_cast<float>((travelTime - bucket.travelTime) / bucket.samples);
+        bucket.congestion += static_cast<float>((congestion - bucket.congestion) / bucket.samples);
+    }
+
+    int size() const { return count; }
+
+    // i = 0 is the newest observation
+    const Observation& recent(int i) const {
+        return ring[(head - 1 - i + 2 * HISTORY_CAPACITY) % HISTORY_CAPACITY];
+    }
+
+    double averageTravelTime() const { return ewmaTravelTime; }
+    double averageCongestion() const { return ewmaCongestion; }
+
+    // Forecast 'minutesAhead' after hour:minute: the time-of-day profile at the target time,
+    // plus the current deviation from the profile decaying exponentially with the horizon.
+    Forecast forecast(int hour, int minute, int minutesAhead) const {
+        Forecast now = profileAt(hour * 60 + minute);
+        Forecast later = profileAt(hour * 60 + minute + minutesAhead);
+        double decay = exp(-minutesAhead / FORECAST_DECAY_MINUTES);
+        Forecast result;
+        result.travelTime = max(0.0, later.travelTime + (ewmaTravelTime - now.travelTime) * decay);
+        result.congestion = min(static_cast<double>(MAX_CONGESTION),
+                                max(0.0, later.congestion + (ewmaCongestion - now.congestion) * decay));
+        return result;
+    }
+
+private:
+    struct Bucket {
+        uint16_t samples = 0;
+        float travelTime = 0;
+        float congestion = 0;
+    };
+
+    Observation ring[HISTORY_CAPACITY];
+    Bucket hourly[24];
+    int head;
+    int count;
+    double ewmaTravelTime;
+    double ewmaCongestion;
+
+    // Profile value at a minute of the day, interpolated between neighbouring hourly buckets;
+    // hours never observed fall back to the EWMA.
+    Forecast profileAt(int minuteOfDay) const {
+        minuteOfDay %= 24 * 60;
+        int hour = minuteOfDay / 60;
+        double t = (minuteOfDay % 60) / 60.0;
+        const Bucket& a = hourly[hour];
+        const Bucket& b = hourly[(hour + 1) % 24];
+        double aTime = a.samples ? a.travelTime : ewmaTravelTime, bTime = b.samples ? b.travelTime : aTime;
+        double aCong = a.samples ? a.congestion : ewmaCongestion, bCong = b.samples ? b.congestion : aCong;
+        return {aTime + (bTime - aTime) * t, aCong + (bCong - aCong) * t};
+    }
+};
+
 // ================ AI OPTIMIZER ================
 class AIOptimizer {
 public:
     void analyze(const string& start, const string& end) {
         cout << AI_COLOR << "\n🤖 AI OPTIMIZER ACTIVATED\n";
+        Xoshiro256& rng = simulationRng();
         cout << "• Scanning traffic patterns between " << start << " and " << end << "...\n";
-        cout << "• Analyzing " << 15 + rand()%10 << " route variations...\n";
+        cout << "• Analyzing " << 15 + rng.below(10) << " route variations...\n";
 
-        int timeSave = 15 + rand()%20;
-        string bestRoute = (rand()%2) ? "via City Center" : "via Ring Road";
+        int timeSave = 15 + rng.below(20);
+        string bestRoute = rng.below(2) ? "via City Center" : "via Ring Road";
         cout << "✔ Recommendation: " << bestRoute << " saves ~" << timeSave << "% time\n";
-        cout << "⚠ Warning: " << 3 + rand()%5 << " congestion points detected\n" << RESET;
+        cout << "⚠ Warning: " << 3 + rng.below(5) << " congestion points detected\n" << RESET;
     }
 
     void optimizeTrafficLights() {
-        if (rand() % 2 == 0) { // Optimize occasionally
+        Xoshiro256& rng = simulationRng();
+        if (rng.below(2) == 0) { // Optimize occasionally
             cout << AI_COLOR << "\n🖥️ AI TRAFFIC LIGHT OPTIMIZATION\n";
-            cout << "• Synchronizing " << 10 + rand()%15 << " intersections...\n";
-            cout << "• Estimated delay reduction: " << 20 + rand()%25 << "%\n" << RESET;
+            cout << "• Synchronizing " << 10 + rng.below(15) << " intersections...\n";
+            cout << "• Estimated delay reduction: " << 20 + rng.below(25) << "%\n" << RESET;
         }
     }
 
-    void predictCongestion(const string& start, const string& end) {
+    // Forecasts the next hour for a route from the history of the roads along it.
+    void predictCongestion(const string& start, const string& end, const vector<const EdgeHistory*>& route) {
         cout << AI_COLOR << "\n🧠 PREDICTIVE ANALYSIS:\n";
-        int jamRisk = rand() % 100;
-        if (jamRisk > 70) {
-            cout << RED << "⚠️ High congestion risk (" << jamRisk << "%) on "
-                 << start << "→" << end << " between "
-                 << rand() % 3 + 4 << "PM-" << rand() % 3 + 7 << "PM\n"; // More realistic time range (4-7 PM)
+        if (route.empty()) {
+            cout << RED << "No drivable route between " << start << " and " << end << " to forecast.\n" << RESET;
+            return;
+        }
+        for (const EdgeHistory* history : route) {
+            if (history->size() == 0) {
+                cout << YELLOW << "Not enough traffic history yet for " << start << "→" << end
+                     << ". Keep the simulation running and try again.\n" << RESET;
+                return;
+            }
+        }
+
+        time_t now = time(nullptr);
+        tm local = *localtime(&now);
+        int peakRisk = 0, peakMinutes = 0;
+        for (int ahead = 0; ahead <= 60; ahead += 15) {
+            double routeTime = 0, weightedCongestion = 0;
+            for (const EdgeHistory* history : route) {
+                EdgeHistory::Forecast f = history->forecast(local.tm_hour, local.tm_min, ahead);
+                routeTime += f.travelTime;
+                weightedCongestion += f.congestion * f.travelTime; // Long roads matter more
+            }
+            int jamRisk = routeTime > 0 ? static_cast<int>(round(100 * weightedCongestion / (routeTime * MAX_CONGESTION))) : 0;
+            if (jamRisk > peakRisk) { peakRisk = jamRisk; peakMinutes = ahead; }
+            string color = jamRisk > 70 ? RED : (jamRisk > 40 ? YELLOW : GREEN);
+            cout << AI_COLOR << "  +" << setw(2) << ahead << " min: " << color << "~" << fixed << setprecision(0)
+                 << routeTime << "s, jam risk " << jamRisk << "%\n";
+        }
+        if (peakRisk > 70) {
+            cout << RED << "⚠️ High congestion risk (" << peakRisk << "%) on " << start << "→" << end
+                 << " in about " << peakMinutes << " minutes\n";
         } else {
-            cout << GREEN << "✅ Smooth traffic expected (" << 100-jamRisk << "% clear)\n";
+            cout << GREEN << "✅ Smooth traffic expected (" << 100 - peakRisk << "% clear)\n";
         }
         cout << RESET;
     }
 };
 
-// ================ GRAPH CLASS ================
-class Graph {
-private:
-    struct Edge {
-        string destination;
-        double weight;       // Changed to double for weather multipliers to retain precision
-        int signalDelay;
-        bool blocked;        // Can be set by incidents or manually
-        int congestion;      // Level of congestion (0-MAX_CONGESTION)
-        string roadType;     // Type of road: General, Highway, Bike Lane, etc.
+// ================ ORIGIN-DESTINATION DEMAND ================
+// Trips per hour between pairs of nodes, used by traffic assignment.
+struct DemandMatrix {
+    map<pair<string, string>, double> trips; // Key is {origin, destination}
 
-        Edge() : destination(""), weight(0.0), signalDelay(0), blocked(false), congestion(0), roadType("General") {}
-        Edge(const string& d, double w, int sd, string rt = "General")
-            : destination(d), weight(w), signalDelay(sd), blocked(false), congestion(0), roadType(rt) {}
+    void add(const string& origin, const string& destination, double volume) {
+        if (origin == destination || volume <= 0) return; // Intra-zonal trips never touch the network
+        trips[{origin, destination}] += volume;
+    }
+
+    // Reads "Origin,Destination,Trips" lines; a header line and malformed rows are skipped.
+    bool loadFromCSV(const string& filename) {
+        ifstream in(filename);
+        if (!in.is_open()) return false;
+        string line;
+        while (getline(in, line)) {
+            stringstream ss(line);
+            string origin, destination, volumeStr;
+            if (!getline(ss, origin, ',') || !getline(ss, destination, ',') || !getline(ss, volumeStr)) continue;
+            try { add(origin, destination, stod(volumeStr)); } catch (...) {} // Header or bad number
+        }
+        return true;
+    }
+
+    double totalTrips() const {
+        double total = 0;
+        for (const auto& od : trips) total += od.second;
+        return total;
+    }
+};
+
+// Hourly capacity (vehicles/hour) of one direction of a road, by road type.
+double getRoadCapacity(const string& roadType) {
+    static map<string, double> capacities = {
+        {"Highway", 2000}, {"Bridge", 1500}, {"Tunnel", 1500}, {"General", 800},
+        {"Bus Lane", 400}, {"Bike Lane", 300}, {"Emergency", 200}
     };
+    return capacities.count(roadType) ? capacities.at(roadType) : 800;
+}
 
-    map<string, vector<Edge>> adjList;
-    // Store original edge properties separately to re-apply effects consistently
-    // This map stores the 'base' properties of each road segment, without temporary effects.
-    map<pair<string, string>, Edge> baseEdges; // Key is {source, destination} to identify unique roads
+// BPR volume-delay function: congested time of a road carrying 'volume' vehicles/hour.
+double volumeDelay(double freeFlowTime, double volume, double capacity) {
+    return freeFlowTime * (1.0 + 0.15 * pow(volume / capacity, 4));
+}
 
-    // IncidentMonitor is now a Singleton, access via getInstance()
-    // IncidentMonitor monitor; // No longer needed as a member variable
+// Integral of volumeDelay from 0 to 'volume' (one term of the Beckmann objective).
+double volumeDelayIntegral(double freeFlowTime, double volume, double capacity) {
+    return freeFlowTime * (volume + 0.03 * capacity * pow(volume / capacity, 5));
+}
 
-    AIOptimizer ai;
+// ================ STREAMING TELEMETRY EXPORT ================
+// Appends per-tick simulation state to disk from a background thread, so the tick itself only
+// copies a few columns and never waits on I/O.
+//
+// Columnar stream (.tscol): all integers little-endian, the file is a sequence of blocks
+//   file/session header  "TSCOL1\n" (a new session may start anywhere; codes restart with it)
+//   block                [u8 kind][u32 tick][u32 rows][u8 columns], then per column
+//                        [u8 encoding][u32 payload bytes][payload]
+//   'D' dictionary       strings appended to the session dictionary (u32 length + bytes each);
+//                        node names, road types and incident labels are stored as codes into it
+//   'S' static edges     edge id, source code, destination code, road type code, base weight, signal delay
+//   'E' edge state       weight, congestion, blocked, flow; row i describes edge id i
+//   'T' trips            source code, destination code, vehicle type, travel time
+//   'I' incidents        location code, type code, severity, road type code
+//   encodings            0 plain, 1 run-length (u8: value + varint run), 2 zigzag delta varint (u32)
+//
+// The CSV fallback appends rows to <base>_edges.csv, <base>_trips.csv and <base>_incidents.csv.
+enum TelemetryFormat { TELEMETRY_COLUMNAR, TELEMETRY_CSV };
+
+struct TelemetryFrame {
+    uint32_t tick = 0;
+    vector<string> newStrings; // Dictionary entries first used by this frame
+
+    // Edges added since the previous frame
+    vector<uint32_t> staticId, staticSource, staticDestination, staticRoadType, staticSignalDelay;
+    vector<float> staticBaseWeight;
 
+    // Current state of every edge, indexed by edge id
+    vector<float> weight, flow;
+    vector<uint8_t> congestion, blocked;
+
+    vector<uint32_t> tripSource, tripDestination, tripTime;
+    vector<uint8_t> tripVehicle;
+
+    vector<uint32_t> incidentLocation, incidentType, incidentRoadType;
+    vector<uint8_t> incidentSeverity;
+};
+
+// Appends 'value' with up to three decimals and no trailing zeros (fast replacement for ostream <<).
+void appendNumber(string& out, double value) {
+    if (value < 0) { out += '-'; value = -value; }
+    unsigned long long scaled = static_cast<unsigned long long>(value * 1000.0 + 0.5);
+    out += to_string(scaled / 1000);
+    unsigned fraction = static_cast<unsigned>(scaled % 1000);
+    if (fraction == 0) return;
+    char digits[4] = {static_cast<char>('0' + fraction / 100), static_cast<char>('0' + fraction / 10 % 10),
+                      static_cast<char>('0' + fraction % 10), 0};
+    int length = 3;
+    while (digits[length - 1] == '0') --length;
+    out += '.';
+    out.append(digits, length);
+}
+
+class TelemetryExporter {
 public:
-    // ================ ENHANCED VISUALIZATION ================
-    void showEnhancedMap() {
-        cout << CYAN << "\n🌍 LIVE TRAFFIC MAP 🌍\n" << RESET;
-        if (adjList.empty()) {
-            cout << "Map is empty. Please add some roads first (Option 1).\n";
-            return;
-        }
-        for (auto& node : adjList) {
-            cout << BOLD << "🟢 " << node.first << RESET << " [" << getRoadTypeDisplayName(node.first) << "]\n";
-            for (auto& edge : node.second) {
-                // Determine color based on status
-                string statusColor = edge.blocked ? RED : GREEN;
-                string emojiStatus = edge.blocked ? "⛔" : "✅";
-                string congestionInfo = "";
-                if (edge.congestion > 0) {
-                    congestionInfo = YELLOW + " (" + to_string(edge.congestion) + " cars)" + RESET;
-                }
+    ~TelemetryExporter() { stop(); }
 
-                cout << "    " << emojiStatus << statusColor << " " << edge.destination << RESET << " ("
-                     << fixed << setprecision(0) << edge.weight << "s, " << edge.roadType << ")"
-                     << congestionInfo << "\n";
+    bool start(TelemetryFormat fmt, const string& path, bool compressColumns) {
+        stop();
+        format = fmt;
+        compress = compressColumns;
+        codes.clear();
+        edgesSent = 0;
+        pending = TelemetryFrame();
+        writerStrings.clear();
+        writerEdges.clear();
+        framesWritten = 0; bytesWritten = 0; framesDropped = 0;
+
+        if (format == TELEMETRY_COLUMNAR) {
+            files[0] = fopen(path.c_str(), "ab");
+            if (!files[0]) return false;
+            buffers[0] = "TSCOL1\n";
+        } else {
+            const char* suffixes[3] = {"_edges.csv", "_trips.csv", "_incidents.csv"};
+            const char* headers[3] = {
+                "Tick,Source,Destination,RoadType,Weight,Congestion,Blocked,Flow\n",
+                "Tick,Source,Destination,Vehicle,TravelTime\n",
+                "Tick,Location,Type,Severity,RoadType\n"};
+            for (int i = 0; i < 3; ++i) {
+                files[i] = fopen((path + suffixes[i]).c_str(), "ab");
+                if (!files[i]) { closeFiles(); return false; }
+                fseek(files[i], 0, SEEK_END);
+                if (ftell(files[i]) == 0) buffers[i] = headers[i]; // Header only for fresh files
             }
         }
-    }
+        for (FILE* file : files) if (file) setvbuf(file, nullptr, _IONBF, 0); // We buffer ourselves
 
-    // Helper to get a nicer display name for road types (could be improved to use enums)
-    string getRoadTypeDisplayName(const string& node) {
-        if (node.find("Highway") != string::npos) return "Highway";
-        if (node.find("Bridge") != string::npos) return "Bridge";
-        if (node.find("Bike") != string::npos) return "Bike Lane";
-        if (node.find("Bus") != string::npos) return "Bus Lane";
-        if (node.find("Tunnel") != string::npos) return "Tunnel";
-        if (node.find("Airport") != string::npos) return "Airport Access";
-        if (node.find("Hospital") != string::npos) return "Hospital Access";
-        return "General";
+        running = true;
+        writer = thread(&TelemetryExporter::writerLoop, this);
+        return true;
     }
 
-    // ================ EMERGENCY SYSTEM ================
-    void playSiren() {
-#ifdef _WIN32 // Conditionally compile Beep for Windows
-        // Beep frequency and duration adjustments for a more "siren-like" sound
-        for (int i = 0; i < 3; ++i) { // Repeat a few times
-            Beep(600, 150); // Lower tone
-            Beep(900, 150); // Higher tone
-            Beep(600, 150);
-            Beep(900, 150);
-            Sleep(100); // Short pause between cycles
+    void stop() {
+        if (!running) return;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            running = false;
         }
-#endif
-        cout << EMERGENCY_COLOR << "\n🚨 ALL VEHICLES YIELD TO EMERGENCY VEHICLE! 🚨\n" << RESET;
-    }
-
-    // ================ ROAD MANAGEMENT ================
-    void addRoad(const string& u, const string& v, int w, int sd, string roadType = "General") {
-        // Add road in both directions for a bidirectional graph
-        adjList[u].push_back(Edge(v, w, sd, roadType));
-        adjList[v].push_back(Edge(u, w, sd, roadType));
-        // Store original edge properties for later use (e.g., reverting rush hour effects, weather)
-        baseEdges[{u, v}] = Edge(v, w, sd, roadType);
-        baseEdges[{v, u}] = Edge(u, w, sd, roadType);
-        cout << GREEN << "Road added: " << u << " <-> " << v << " (" << roadType << ")\n" << RESET;
+        queueReady.notify_one();
+        writer.join();
+        closeFiles();
     }
 
-    // ================ FUEL & ENVIRONMENT STATS ================
-    void showEcoStats(const Vehicle& vehicle, double distance) {
-        // Simplified CO2 calculation (approximate, kg per 1000 units of distance)
-        double co2PerDistanceUnit = 0.12; // Base kg CO2 per distance unit (e.g., meter)
-        if (vehicle.type == BUS) co2PerDistanceUnit *= 2.5; // Buses produce more CO2
-        else if (vehicle.type == BIKE) co2PerDistanceUnit = 0; // Bikes are zero emission
+    bool active() const { return running; }
 
-        // Fuel efficiency as "units of distance per fuel unit" (inverse of fuelRate)
-        double fuelEfficiency = (vehicle.fuelRate > 0) ? (1.0 / vehicle.fuelRate) : 0; // Higher value is better
+    // ---- Capture side (simulation thread only) ----
 
-        cout << GREEN << "♻️ Eco Stats for " << vehicle.name << " journey:\n"
-             << "   CO2 Emission: " << fixed << setprecision(2) << distance * co2PerDistanceUnit << " kg\n"
-             << "   Relative Fuel Efficiency: " << fixed << setprecision(2) << fuelEfficiency << " units/fuel unit\n" << RESET;
+    // Dictionary code for a string, announcing new entries through the pending frame.
+    uint32_t code(const string& text) {
+        auto it = codes.find(text);
+        if (it != codes.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(codes.size());
+        codes[text] = id;
+        pending.newStrings.push_back(text);
+        return id;
     }
 
-    // ================ TOLL SYSTEM ================
-    int getTollFee(const string& roadType) {
-        static map<string, int> tolls = {
-            {"Highway", 5}, {"Bridge", 3}, {"Tunnel", 7}
-        };
-        return tolls.count(roadType) ? tolls.at(roadType) : 0; // Use .at() for const correctness
+    void recordTrip(const string& source, const string& destination, int vehicleType, int travelTime) {
+        if (!running) return;
+        pending.tripSource.push_back(code(source));
+        pending.tripDestination.push_back(code(destination));
+        pending.tripVehicle.push_back(static_cast<uint8_t>(vehicleType));
+        pending.tripTime.push_back(static_cast<uint32_t>(travelTime));
     }
 
-    // ================ SHORTEST PATH WITH ALL FEATURES ================
-    void shortestPath(const string& src, const string& dest, Vehicle vehicle) {
-        // Edge Case Check: Source and destination are identical
-        if (src == dest) {
-            cout << RED << "Error: Source and destination are identical! No route needed.\n" << RESET;
-            return;
-        }
-
-        // Edge Case Check: Source or destination node doesn't exist
-        if (adjList.find(src) == adjList.end()) {
-            cout << RED << "Error: Source node '" << src << "' doesn't exist in the map!\n" << RESET;
-            return;
-        }
-        if (adjList.find(dest) == adjList.end()) {
-            cout << RED << "Error: Destination node '" << dest << "' doesn't exist in the map!\n" << RESET;
-            return;
-        }
-
-        // Performance Metrics: Start timer
-        auto start_time = chrono::high_resolution_clock::now();
-
-        if (vehicle.emergency) playSiren();
+    void recordIncident(const string& location, const string& type, int severity, const string& roadType) {
+        if (!running) return;
+        pending.incidentLocation.push_back(code(location));
+        pending.incidentType.push_back(code(type));
+        pending.incidentSeverity.push_back(static_cast<uint8_t>(severity));
+        pending.incidentRoadType.push_back(code(roadType));
+    }
 
-        // Apply weather effects just before pathfinding starts, ensuring current conditions apply
-        applyWeatherEffects();
+    // Number of edges whose static rows have already been emitted this session
+    int staticEdgesSent() const { return edgesSent; }
 
-        map<string, int> dist;
-        map<string, string> parent;
-        // Priority queue stores {current_total_time, node_name}
-        // `greater` makes it a min-priority queue (smallest time at top)
-        priority_queue<pair<int, string>, vector<pair<int, string>>, greater<pair<int, string>>> pq;
+    // The frame being assembled; the caller fills edge columns, then calls submit().
+    TelemetryFrame& frame() { return pending; }
 
-        // Initialize distances to infinity
-        for (auto& node : adjList) dist[node.first] = numeric_limits<int>::max();
-        dist[src] = 0; // Distance to source is 0
-        pq.push({0, src}); // Start Dijkstra's from source
+    // Hands the pending frame to the writer. Never blocks on I/O: if the writer has fallen
+    // too far behind, the edge state is dropped (static rows, trips and incidents are kept).
+    void submit(uint32_t tick, int totalEdges) {
+        pending.tick = tick;
+        edgesSent = totalEdges;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (queue.size() >= TELEMETRY_QUEUE_LIMIT) {
+                ++framesDropped;
+                pending.weight.clear(); pending.flow.clear();
+                pending.congestion.clear(); pending.blocked.clear();
+            }
+            queue.push_back(move(pending));
+        }
+        queueReady.notify_one();
+        pending = TelemetryFrame();
+    }
 
-        while (!pq.empty()) {
-            auto current = pq.top();
-            pq.pop();
-            int current_dist = current.first;
-            string u = current.second;
+    // One block of a columnar stream as read back: every column widened to u32 (floats as their
+    // bit patterns). Dictionary blocks have no columns; their strings go to the dictionary.
+    struct Block {
+        char kind;
+        uint32_t tick;
+        uint32_t rows;
+        vector<vector<uint32_t>> columns;
+    };
 
-            if (u == dest) break; // Found the destination, can stop early
-            if (current_dist > dist[u]) continue; // Already found a shorter path to 'u'
-
-            for (auto& edge : adjList.at(u)) { // Use .at() for memory safety with map access
-                // Check for general blockage or specific incident affecting this road
-                bool isBlockedByIncident = false;
-                for (const auto& incident : IncidentMonitor::getInstance().getIncidents()) { // Singleton access
-                    // Check if incident location is near the edge, and if road type matches
-                    if ((incident.location == edge.destination || incident.location == u ||
-                         (baseEdges.count({u, edge.destination}) && incident.location == getRoadTypeDisplayName(u))) &&
-                        (incident.roadType == edge.roadType || incident.roadType == "All" || edge.roadType.find(incident.roadType) != string::npos)) {
-                        isBlockedByIncident = true;
-                        break;
+    // Reads a .tscol file back for tools and tests. 'dictionary' holds the strings of the last
+    // session in the file. False if the file is missing or a block is cut short.
+    static bool readColumnar(const string& path, vector<Block>& blocks, vector<string>& dictionary) {
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        const string header = "TSCOL1\n";
+        size_t at = 0;
+        auto getU8 = [&](uint32_t& v) { if (at + 1 > data.size()) return false; v = static_cast<uint8_t>(data[at++]); return true; };
+        auto getU32 = [&](uint32_t& v) {
+            if (at + 4 > data.size()) return false;
+            v = 0;
+            for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(data[at++])) << (8 * i);
+            return true;
+        };
+        blocks.clear();
+        dictionary.clear();
+        while (at < data.size()) {
+            if (data.compare(at, header.size(), header) == 0) {
+                at += header.size();
+                dictionary.clear(); // Codes restart with each session
+                continue;
+            }
+            Block block;
+            uint32_t kind, columns;
+            if (!getU8(kind) || !getU32(block.tick) || !getU32(block.rows) || !getU8(columns)) return false;
+            block.kind = static_cast<char>(kind);
+            for (uint32_t c = 0; c < columns; ++c) {
+                uint32_t encoding, bytes;
+                if (!getU8(encoding) || !getU32(bytes) || at + bytes > data.size()) return false;
+                size_t end = at + bytes;
+                vector<uint32_t> column;
+                if (block.kind == 'D') {
+                    for (uint32_t length; at < end && getU32(length) && at + length <= end; at += length) dictionary.push_back(data.substr(at, length));
+                } else if (encoding == RUN_LENGTH) {
+                    while (at < end) {
+                        uint32_t value, run = 0;
+                        getU8(value);
+                        for (int shift = 0; at < end; shift += 7) {
+                            uint8_t byte = static_cast<uint8_t>(data[at++]);
+                            run |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                            if (!(byte & 0x80)) break;
+                        }
+                        column.insert(column.end(), run, value);
                     }
+                } else if (encoding == DELTA_VARINT) {
+                    uint32_t previous = 0;
+                    while (at < end) {
+                        uint32_t zigzag = 0;
+                        for (int shift = 0; at < end; shift += 7) {
+                            uint8_t byte = static_cast<uint8_t>(data[at++]);
+                            zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                            if (!(byte & 0x80)) break;
+                        }
+                        previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+                        column.push_back(previous);
+                    }
+                } else if (bytes == block.rows) { // Plain u8
+                    for (; at < end; ++at) column.push_back(static_cast<uint8_t>(data[at]));
+                } else {                          // Plain u32 or float
+                    for (uint32_t v; at < end && getU32(v);) column.push_back(v);
                 }
+                at = end;
+                if (block.kind != 'D') block.columns.push_back(move(column));
+            }
+            blocks.push_back(move(block));
+        }
+        return true;
+    }
 
-                if (edge.blocked || isBlockedByIncident) {
-                    continue; // Skip blocked roads
-                }
-                if (!vehicle.canUseRoad(edge.roadType)) {
-                    continue; // Skip roads not allowed for this vehicle type
-                }
+    void showStatus() const {
+        cout << "Telemetry stream: " << (running ? GREEN + "active" : YELLOW + "stopped") << RESET
+             << " | frames written: " << framesWritten << " | dropped: " << framesDropped
+             << " | bytes: " << bytesWritten << "\n";
+    }
 
-                // Calculate total time cost for this segment
-                double effectiveWeight = edge.weight; // Base weight already adjusted by weather
-                effectiveWeight *= (1.0 + (edge.congestion * 0.1)); // Add 10% delay per congestion unit
-                int timeCost = static_cast<int>((effectiveWeight + edge.signalDelay) / vehicle.speedMultiplier);
+private:
+    static constexpr size_t TELEMETRY_QUEUE_LIMIT = 256;     // Frames waiting for the writer
+    static constexpr size_t TELEMETRY_FLUSH_BYTES = 1 << 20; // Write in 1 MiB chunks
 
-                if (dist.at(u) + timeCost < dist.at(edge.destination)) { // Use .at() for memory safety
-                    dist.at(edge.destination) = dist.at(u) + timeCost; // Use .at() for memory safety
-                    parent[edge.destination] = u;
-                    pq.push({dist.at(edge.destination), edge.destination}); // Use .at() for memory safety
-                }
+    enum ColumnEncoding : uint8_t { PLAIN = 0, RUN_LENGTH = 1, DELTA_VARINT = 2 };
+
+    TelemetryFormat format = TELEMETRY_COLUMNAR;
+    bool compress = true;
+
+    // Capture side
+    unordered_map<string, uint32_t> codes;
+    int edgesSent = 0;
+    TelemetryFrame pending;
+
+    // Hand-off
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<TelemetryFrame> queue;
+    atomic<bool> running{false};
+    thread writer;
+
+    // Writer side
+    FILE* files[3] = {nullptr, nullptr, nullptr};
+    string buffers[3];
+    vector<string> writerStrings;   // Session dictionary, rebuilt from frames for CSV rows
+    vector<uint32_t> writerEdges;   // Per edge id: source, destination, road type codes (flattened)
+    atomic<uint64_t> framesWritten{0}, bytesWritten{0}, framesDropped{0};
+
+    void writerLoop() {
+        vector<TelemetryFrame> batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return !queue.empty() || !running; });
+                for (auto& f : queue) batch.push_back(move(f));
+                queue.clear();
+            }
+            for (const auto& f : batch) {
+                if (format == TELEMETRY_COLUMNAR) encodeColumnar(f); else encodeCSV(f);
+                ++framesWritten;
+            }
+            batch.clear();
+            bool stopping = !running;
+            for (int i = 0; i < 3; ++i) {
+                if (files[i] && (stopping || buffers[i].size() >= TELEMETRY_FLUSH_BYTES)) flushBuffer(i);
+            }
+            if (stopping) {
+                lock_guard<mutex> lock(queueMutex);
+                if (queue.empty()) return;
             }
         }
+    }
 
-        // Performance Metrics: End timer and display duration
-        auto end_time = chrono::high_resolution_clock::now();
-        cout << "Route calculation took: "
-             << chrono::duration_cast<chrono::milliseconds>(end_time-start_time).count()
-             << "ms\n";
+    void flushBuffer(int i) {
+        if (buffers[i].empty()) return;
+        bytesWritten += fwrite(buffers[i].data(), 1, buffers[i].size(), files[i]);
+        buffers[i].clear();
+    }
 
-        if (dist.at(dest) == numeric_limits<int>::max()) { // Use .at() for memory safety
-            cout << RED << "No path exists from " << src << " to " << dest << " for " << vehicle.name << "!\n" << RESET;
-            return;
+    void closeFiles() {
+        for (FILE*& file : files) {
+            if (file) fclose(file);
+            file = nullptr;
         }
+        for (string& buffer : buffers) buffer.clear();
+    }
 
-        // Reconstruct the path
-        vector<string> path;
-        for (string v = dest; v != src; v = parent.at(v)) path.push_back(v); // Use .at() for memory safety
-        path.push_back(src);
-        reverse(path.begin(), path.end()); // Reverse to get path from source to destination
-
-        cout << GREEN << "\nRoute for " << vehicle.emoji << " " << vehicle.name << ":\n" << RESET;
-        double totalDistance = 0;
-        int totalToll = 0;
+    // ---- Columnar encoding ----
+    static void putU8(string& out, uint8_t v) { out += static_cast<char>(v); }
+    static void putU32(string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out += static_cast<char>((v >> (8 * i)) & 0xFF);
+    }
+    static void putVarint(string& out, uint32_t v) {
+        while (v >= 0x80) { out += static_cast<char>((v & 0x7F) | 0x80); v >>= 7; }
+        out += static_cast<char>(v);
+    }
+    static void putColumnHeader(string& out, uint8_t encoding, const string& payload) {
+        putU8(out, encoding);
+        putU32(out, static_cast<uint32_t>(payload.size()));
+        out += payload;
+    }
 
-        for (size_t i = 0; i < path.size(); ++i) {
-            cout << BOLD << path.at(i) << RESET; // Use .at() for memory safety
-            if (i != path.size() - 1) {
-                // Find the edge corresponding to the current segment to get its original weight and road type
-                for (auto& edge : adjList.at(path.at(i))) { // Use .at() for memory safety
-                    if (edge.destination == path.at(i+1)) { // Use .at() for memory safety
-                        // Use the original base weight for total distance calculation (not affected by weather/congestion)
-                        double segmentDistance = 0;
-                        if (baseEdges.count({path.at(i), edge.destination})) { // Use .at() for memory safety
-                            segmentDistance = baseEdges.at({path.at(i), edge.destination}).weight; // Use .at() for memory safety
-                        } else if (baseEdges.count({edge.destination, path.at(i)})) { // Check reverse direction if needed, use .at() for memory safety
-                            segmentDistance = baseEdges.at({edge.destination, path.at(i)}).weight; // Use .at() for memory safety
-                        }
-                        totalDistance += segmentDistance;
+    void putColumn(string& out, const vector<uint8_t>& column) {
+        string payload;
+        if (compress) {
+            for (size_t i = 0; i < column.size();) {
+                size_t run = 1;
+                while (i + run < column.size() && column[i + run] == column[i]) ++run;
+                putU8(payload, column[i]);
+                putVarint(payload, static_cast<uint32_t>(run));
+                i += run;
+            }
+        } else {
+            payload.assign(column.begin(), column.end());
+        }
+        putColumnHeader(out, compress ? RUN_LENGTH : PLAIN, payload);
+    }
 
-                        int toll = getTollFee(edge.roadType); // Get toll based on road type
-                        if (toll > 0) {
-                            cout << YELLOW << " [Toll: $" << toll << "]" << RESET;
-                            totalToll += toll;
-                        }
-                        break;
-                    }
-                }
-                cout << " -> ";
+    void putColumn(string& out, const vector<uint32_t>& column) {
+        string payload;
+        if (compress) {
+            uint32_t previous = 0;
+            for (uint32_t v : column) {
+                int32_t delta = static_cast<int32_t>(v - previous);
+                putVarint(payload, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+                previous = v;
             }
+        } else {
+            for (uint32_t v : column) putU32(payload, v);
         }
-        cout << "\n⏱️ Total time: " << dist.at(dest) << "s"; // Use .at() for memory safety
-        if (totalToll > 0) {
-            cout << YELLOW << " | 💲 Total Toll: $" << totalToll << RESET;
+        putColumnHeader(out, compress ? DELTA_VARINT : PLAIN, payload);
+    }
+
+    void putColumn(string& out, const vector<float>& column) {
+        string payload;
+        for (float v : column) {
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof bits);
+            putU32(payload, bits);
         }
-        cout << endl;
+        putColumnHeader(out, PLAIN, payload);
+    }
 
-        showEcoStats(vehicle, totalDistance);
-        simulateTimeDelay(dist.at(dest)); // Use .at() for memory safety
+    void putColumn(string& out, const vector<string>& column) {
+        string payload;
+        for (const string& text : column) {
+            putU32(payload, static_cast<uint32_t>(text.size()));
+            payload += text;
+        }
+        putColumnHeader(out, PLAIN, payload);
     }
 
-    // ================ DATA EXPORT ================
-    void exportToCSV() {
-        ofstream out("traffic_data.csv");
-        if (!out.is_open()) {
-            cout << RED << "Error: Could not open traffic_data.csv for writing. Check permissions.\n" << RESET;
-            return;
+    static void putBlockHeader(string& out, char kind, uint32_t tick, size_t rows, uint8_t columns) {
+        putU8(out, static_cast<uint8_t>(kind));
+        putU32(out, tick);
+        putU32(out, static_cast<uint32_t>(rows));
+        putU8(out, columns);
+    }
+
+    void encodeColumnar(const TelemetryFrame& f) {
+        string& out = buffers[0];
+        if (!f.newStrings.empty()) {
+            putBlockHeader(out, 'D', f.tick, f.newStrings.size(), 1);
+            putColumn(out, f.newStrings);
         }
-        out << "Source,Destination,RoadType,OriginalWeight,CurrentWeight,SignalDelay,Blocked,Congestion\n";
-        for (auto& node : adjList) {
-            for (auto& edge : node.second) {
-                // Fetch original weight from baseEdges for the CSV export
-                double originalWeight = 0;
-                if (baseEdges.count({node.first, edge.destination})) {
-                    originalWeight = baseEdges.at({node.first, edge.destination}).weight;
-                } else if (baseEdges.count({edge.destination, node.first})) {
-                    originalWeight = baseEdges.at({edge.destination, node.first}).weight;
-                }
-                out << node.first << "," << edge.destination << ","
-                    << edge.roadType << "," << originalWeight << ","
-                    << edge.weight << "," << edge.signalDelay << ","
-                    << (edge.blocked ? "TRUE" : "FALSE") << "," << edge.congestion << "\n";
-            }
+        if (!f.staticId.empty()) {
+            putBlockHeader(out, 'S', f.tick, f.staticId.size(), 6);
+            putColumn(out, f.staticId);
+            putColumn(out, f.staticSource);
+            putColumn(out, f.staticDestination);
+            putColumn(out, f.staticRoadType);
+            putColumn(out, f.staticBaseWeight);
+            putColumn(out, f.staticSignalDelay);
+        }
+        if (!f.weight.empty()) {
+            putBlockHeader(out, 'E', f.tick, f.weight.size(), 4);
+            putColumn(out, f.weight);
+            putColumn(out, f.congestion);
+            putColumn(out, f.blocked);
+            putColumn(out, f.flow);
+        }
+        if (!f.tripSource.empty()) {
+            putBlockHeader(out, 'T', f.tick, f.tripSource.size(), 4);
+            putColumn(out, f.tripSource);
+            putColumn(out, f.tripDestination);
+            putColumn(out, f.tripVehicle);
+            putColumn(out, f.tripTime);
+        }
+        if (!f.incidentLocation.empty()) {
+            putBlockHeader(out, 'I', f.tick, f.incidentLocation.size(), 4);
+            putColumn(out, f.incidentLocation);
+            putColumn(out, f.incidentType);
+            putColumn(out, f.incidentSeverity);
+            putColumn(out, f.incidentRoadType);
         }
-        out.close();
-        cout << GREEN << "📊 Data exported to traffic_data.csv\n" << RESET;
     }
 
-    // ================ TUTORIAL MODE ================
-    void runTutorial() {
-        cout << CYAN << "\n=== INTERACTIVE TUTORIAL ===\n" << RESET;
-        vector<string> steps = {
-            "Welcome to the Traffic Simulation! Let's get started.",
-            "1. First, we need to add roads. Choose option " + BOLD + "1" + RESET + " from the main menu.",
-            "   You'll enter a start node, end node, weight (time in seconds), signal delay, and road type.",
-            "   Try adding: Downtown -> Midtown (300s, 60s, Highway)",
-            "   Then: Midtown -> Market St (120s, 30s, General)",
-            "2. Now, let's view the map. Choose option " + BOLD + "12" + RESET + " (Enhanced Live Map).",
-            "   You should see the roads you added and default ones.",
-            "3. Time to simulate! Choose option " + BOLD + "5" + RESET + " (Calculate Shortest Path).",
-            "   Enter 'Downtown' as source and 'Market St' as destination. Pick 'Car' (option 1).",
-            "   See the route and total time. A progress bar will simulate the journey.",
-            "4. Observe dynamic changes: The simulation automatically updates weather and generates incidents.",
-            "   You can manually generate an incident with option " + BOLD + "3" + RESET + " (Simulate/View Incidents).",
-            "5. Compare vehicle types! Choose option " + BOLD + "6" + RESET + " (Compare Vehicle Routes).",
-            "   Input the same start/end nodes. Notice how an 'Ambulance' takes a shorter time due to emergency speed.",
-            "6. Leverage AI! Choose option " + BOLD + "9" + RESET + " (AI Traffic Analysis).",
-            "   Enter start/end nodes to get route recommendations and congestion predictions.",
-            "7. Explore other features: 'Time Controls' (" + BOLD + "13" + RESET + "), 'City Stats' (" + BOLD + "11" + RESET + "), and 'Export Data' (" + BOLD + "14" + RESET + ").",
-            "That's it for the basic tutorial! Enjoy exploring the traffic simulation."
-        };
+    // ---- CSV fallback ----
+    void encodeCSV(const TelemetryFrame& f) {
+        writerStrings.insert(writerStrings.end(), f.newStrings.begin(), f.newStrings.end());
+        for (size_t i = 0; i < f.staticId.size(); ++i) {
+            writerEdges.push_back(f.staticSource[i]);
+            writerEdges.push_back(f.staticDestination[i]);
+            writerEdges.push_back(f.staticRoadType[i]);
+        }
+        string tick = to_string(f.tick);
 
-        for (const string& step : steps) {
-            cout << step << endl;
-            sleep_seconds(5); // Give user time to read each step
+        string& edges = buffers[0];
+        for (size_t id = 0; id < f.weight.size(); ++id) {
+            edges += tick; edges += ',';
+            edges += writerStrings[writerEdges[3 * id]]; edges += ',';
+            edges += writerStrings[writerEdges[3 * id + 1]]; edges += ',';
+            edges += writerStrings[writerEdges[3 * id + 2]]; edges += ',';
+            appendNumber(edges, f.weight[id]); edges += ',';
+            edges += static_cast<char>('0' + f.congestion[id]); edges += ',';
+            edges += f.blocked[id] ? "TRUE," : "FALSE,";
+            appendNumber(edges, f.flow[id]); edges += '\n';
+        }
+
+        string& trips = buffers[1];
+        for (size_t i = 0; i < f.tripSource.size(); ++i) {
+            trips += tick; trips += ',';
+            trips += writerStrings[f.tripSource[i]]; trips += ',';
+            trips += writerStrings[f.tripDestination[i]]; trips += ',';
+            trips += to_string(f.tripVehicle[i]); trips += ',';
+            trips += to_string(f.tripTime[i]); trips += '\n';
+        }
+
+        string& incidents = buffers[2];
+        for (size_t i = 0; i < f.incidentLocation.size(); ++i) {
+            incidents += tick; incidents += ',';
+            incidents += writerStrings[f.incidentLocation[i]]; incidents += ',';
+            incidents += writerStrings[f.incidentType[i]]; incidents += ',';
+            incidents += to_string(f.incidentSeverity[i]); incidents += ',';
+            incidents += writerStrings[f.incidentRoadType[i]]; incidents += '\n';
         }
-        cout << GREEN << "\nTutorial finished! Returning to Main Menu.\n" << RESET;
     }
+};
 
-    // ================ STRATEGY PATTERN FOR ROUTING ================
-    class RoutingStrategy {
-    public:
-        virtual void calculate(Graph& g, const string& src,
-                             const string& dest) = 0;
-    };
+// ================ LOCK-FREE EVENT QUEUE ================
+// Bounded single-producer/single-consumer ring. The producer only writes 'tail' and the consumer
+// only writes 'head'; each side caches the other's index so the shared cache lines are touched
+// only when the ring looks full or empty.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) capacity <<= 1; // Power of two so wrap-around is a mask
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
 
-    class FastestRoute : public RoutingStrategy {
-    public:
-        void calculate(Graph& g, const string& src,
-                     const string& dest) override {
-            Vehicle car(CAR); // Default to car for fastest
-            g.shortestPath(src, dest, car);
+    // Producer side. Returns false (and leaves 'item' untouched) when the ring is full.
+    bool tryPush(T& item) {
+        size_t tail = tail_.load(memory_order_relaxed);
+        if (tail - headCache == slots.size()) {
+            headCache = head_.load(memory_order_acquire);
+            if (tail - headCache == slots.size()) return false;
         }
-    };
+        slots[tail & mask] = move(item);
+        tail_.store(tail + 1, memory_order_release);
+        return true;
+    }
 
-    class EmergencyRoute : public RoutingStrategy {
-    public:
-        void calculate(Graph& g, const string& src,
-                     const string& dest) override {
-            Vehicle ambulance(AMBULANCE, true); // Ambulance in emergency mode
-            g.shortestPath(src, dest, ambulance);
+    // Consumer side. Returns false when the ring is empty.
+    bool tryPop(T& out) {
+        size_t head = head_.load(memory_order_relaxed);
+        if (head == tailCache) {
+            tailCache = tail_.load(memory_order_acquire);
+            if (head == tailCache) return false;
         }
-    };
+        out = move(slots[head & mask]);
+        head_.store(head + 1, memory_order_release);
+        return true;
+    }
 
+    size_t capacity() const { return slots.size(); }
+    size_t sizeApprox() const { return tail_.load(memory_order_acquire) - head_.load(memory_order_acquire); }
 
-    // ================ MAIN MENU WITH ALL FEATURES ================
-    void mainMenu() {
-        addDefaultRoads(); // Initialize with some predefined roads
-        string src, dest;
-        int tick = 0; // Simulation "tick" counter for periodic events
+private:
+    vector<T> slots;
+    size_t mask = 0;
+    alignas(64) atomic<size_t> head_{0}; // Next slot to pop (written by the consumer)
+    size_t tailCache = 0;                // Consumer's view of tail_
+    alignas(64) atomic<size_t> tail_{0}; // Next slot to fill (written by the producer)
+    size_t headCache = 0;                // Producer's view of head_
+};
 
-        while (true) {
-            // Periodic updates for dynamic simulation aspects
-            tick++;
-            // Weather updates are now handled by a separate thread
-            if (tick % 10 == 0) IncidentMonitor::getInstance().generateIncident(); // Generate incidents every 10 ticks (Singleton access)
-            if (tick % 30 == 0) ai.optimizeTrafficLights(); // AI optimization every 30 ticks
+// ================ INCIDENT FEED INGESTION ================
+// Replays a recorded city feed (regular file, named pipe, or "unix:/path" stream socket) on a
+// reader thread. Parsed events go through an SPSC ring to the simulation thread, which applies
+// them in batches. One event per line, comma separated:
+//   <time>,INCIDENT,<location>,<road type>,<severity 1-3>,<description>
+//   <time>,CLOSURE,<from>,<to>
+//   <time>,REOPEN,<from>,<to>
+//   <time>,WEATHER,<SUNNY|RAIN|SNOW|FOG|STORM>
+// Blank lines and lines starting with '#' are ignored. <time> is in seconds and only used to
+// pace the replay.
+enum FeedEventKind { FEED_INCIDENT, FEED_CLOSURE, FEED_REOPEN, FEED_WEATHER };
 
-            // Clear console for fresh menu display - improves readability
+struct FeedEvent {
+    FeedEventKind kind = FEED_INCIDENT;
+    double feedTime = 0;
+    chrono::steady_clock::time_point receivedAt;
+    string location;  // Incident location, or start of a closed/reopened road
+    string target;    // End of a closed/reopened road
+    string roadType;
+    string label;     // Incident description
+    int severity = 1;
+    WeatherType weather = SUNNY;
+};
+
+bool parseFeedLine(const string& line, FeedEvent& event) {
+    vector<string> fields;
+    stringstream ss(line);
+    string field;
+    while (getline(ss, field, ',')) fields.push_back(field);
+    if (fields.size() < 3) return false;
+    try { event.feedTime = stod(fields[0]); } catch (...) { return false; }
+
+    const string& kind = fields[1];
+    if (kind == "INCIDENT" && fields.size() >= 5) {
+        event.kind = FEED_INCIDENT;
+        event.location = fields[2];
+        event.roadType = fields[3];
+        try { event.severity = min(3, max(1, stoi(fields[4]))); } catch (...) { return false; }
+        event.label = fields.size() >= 6 ? fields[5] : "📡 Reported Incident";
+        return true;
+    }
+    if ((kind == "CLOSURE" || kind == "REOPEN") && fields.size() >= 4) {
+        event.kind = (kind == "CLOSURE") ? FEED_CLOSURE : FEED_REOPEN;
+        event.location = fields[2];
+        event.target = fields[3];
+        return true;
+    }
+    if (kind == "WEATHER") {
+        static const map<string, WeatherType> names = {
+            {"SUNNY", SUNNY}, {"RAIN", RAIN}, {"SNOW", SNOW}, {"FOG", FOG}, {"STORM", STORM}};
+        auto it = names.find(fields[2]);
+        if (it == names.end()) return false;
+        event.kind = FEED_WEATHER;
+        event.weather = it->second;
+        return true;
+    }
+    return false;
+}
+
+class FeedIngestor {
+public:
+    FeedIngestor() : queue(FEED_QUEUE_CAPACITY) {}
+    ~FeedIngestor() { stop(); }
+
+    // replaySpeed: 0 replays as fast as possible, otherwise feed seconds per wall-clock second.
+    bool start(const string& source, double replaySpeed) {
+        stop();
+        speed = replaySpeed;
+        paced = false;
+        received = 0; malformed = 0; dropped = 0;
+        applied = 0; maxLagMs = 0; totalLagMs = 0;
+        sourceName = source;
 #ifdef _WIN32
-            system("cls"); // For Windows
+        if (source.compare(0, 5, "unix:") == 0) return false; // Sockets/pipes need POSIX here
+        ifstream probe(source);
+        if (!probe.is_open()) return false;
 #else
-            system("clear"); // For Linux/macOS
+        fd = openSource(source);
+        if (fd < 0) return false;
 #endif
+        finishedReading = false;
+        running = true;
+        reader = thread(&FeedIngestor::readerLoop, this);
+        return true;
+    }
 
-            // --- ASCII Art Title (colored) ---
-            cout << BLUE << R"(
-  _____  _____  ___  ______ _____ _   _ _____
- |_   |/  __ \/ _ \ | ___ \_   _| \ | |  __ \
-   | |  | /  \/ /_\ \| |_/ / | | |  \| | |  \/
-   | |  | |   |  _  ||  _ /  | | | . ` | | __
-  _| |_ | \__/\ | | || |\ \| _| |_| |\  | |_\ \
-  \___/  \____|_| |_|_| \_|\___/\_| \_/\____/
-            )" << RESET << endl;
+    void stop() {
+        if (!reader.joinable()) return;
+        running = false;
+        reader.join();
+#ifndef _WIN32
+        if (fd >= 0) close(fd);
+        fd = -1;
+#endif
+    }
 
-            cout << CYAN << "\n=== MAIN MENU ===" << RESET << endl;
-            // Applying colors to menu options
-            cout << GREEN << "1. " << WHITE << "Add Road\n";
-            cout << GREEN << "2. " << WHITE << "View Map (Basic)\n"; // Keeping for compatibility, but 12 is enhanced
-            cout << GREEN << "3. " << WHITE << "Simulate/View Incidents\n";
-            cout << GREEN << "4. " << WHITE << "Apply Rush Hour Conditions\n";
-            cout << GREEN << "5. " << WHITE << "Calculate Shortest Path\n";
-            cout << GREEN << "6. " << WHITE << "Compare Vehicle Routes (Car vs. Ambulance)\n";
-            cout << GREEN << "7. " << WHITE << "Waypoint Routing (Limited)\n";
-            cout << YELLOW << "8. " << WHITE << "Save/Load Data (Not Implemented)\n"; // Indicate non-implemented
-            cout << AI_COLOR << "9. " << WHITE << "AI Traffic Analysis\n";
-            cout << EMERGENCY_COLOR << "10. " << WHITE << "Emergency Mode (Simulate Siren)\n";
-            cout << MAGENTA << "11. " << WHITE << "City Traffic Statistics\n";
-            cout << CYAN << "12. " << WHITE << "Enhanced Live Map\n";
-            cout << YELLOW << "13. " << WHITE << "Time Controls\n";
-            cout << GREEN << "14. " << WHITE << "Export Traffic Data to CSV\n";
-            cout << BLUE << "15. " << WHITE << "Run Interactive Tutorial\n";
-            cout << RED << "0. " << WHITE << "Exit Simulation\n";
-            cout << BOLD << "Select option: " << RESET;
+    bool active() const { return running && !finishedReading; }
+    bool finished() const { return finishedReading; }
 
-            string inputLine;
-            getline(cin, inputLine); // Read the whole line of user input, robust against mixed input
+    // Consumer side: pops up to 'maxEvents' events into 'batch', recording their queueing lag.
+    size_t drain(vector<FeedEvent>& batch, size_t maxEvents) {
+        auto now = chrono::steady_clock::now();
+        size_t count = 0;
+        FeedEvent event;
+        while (count < maxEvents && queue.tryPop(event)) {
+            double lag = chrono::duration<double, milli>(now - event.receivedAt).count();
+            maxLagMs = max(maxLagMs, lag);
+            totalLagMs += lag;
+            batch.push_back(move(event));
+            ++count;
+        }
+        applied += count;
+        return count;
+    }
 
-            int ch;
-            stringstream ss(inputLine);
-            if (!(ss >> ch)) { // Attempt to convert string to int
-                ch = -1; // If conversion fails (e.g., user types text), assign an invalid option
-            }
+    void showStatus() const {
+        cout << "Incident feed: " << (active() ? GREEN + "ingesting" : (finished() ? CYAN + "replay complete" : YELLOW + "stopped"))
+             << RESET << (sourceName.empty() ? "" : " (" + sourceName + ")") << "\n"
+             << "  received: " << received << " | applied: " << applied << " | queued: " << queue.sizeApprox()
+             << " | dropped (queue full): " << dropped << " | malformed: " << malformed << "\n"
+             << "  lag mean/max: " << fixed << setprecision(2) << (applied ? totalLagMs / applied : 0.0)
+             << " / " << maxLagMs << " ms\n";
+    }
 
-            if (ch == 0) {
-                cout << GREEN << "Exiting Traffic Simulation. Goodbye!\n" << RESET;
-                break; // Exit the loop
-            }
+private:
+    static constexpr size_t FEED_QUEUE_CAPACITY = 8192;
 
-            // Using a switch statement for menu navigation
-            switch (ch) {
-                case 1: { // Add Road
-                    string u, v, type;
-                    string w_str, sd_str;
-                    int w_val, sd_val;
+    SpscRing<FeedEvent> queue;
+    thread reader;
+    atomic<bool> running{false}, finishedReading{false};
+    double speed = 0;
+    string sourceName;
+#ifndef _WIN32
+    int fd = -1;
+#endif
 
-                    cout << "Enter start node: ";
-                    getline(cin, u);
-                    // Input Validation: Start node cannot be empty
-                    if (u.empty()) {
-                        cout << RED << "Error: Start node name cannot be empty!\n" << RESET;
-                        break;
-                    }
+    // Producer-side counters (read by the status display)
+    atomic<uint64_t> received{0}, malformed{0}, dropped{0};
+    // Consumer-side counters (simulation thread only)
+    uint64_t applied = 0;
+    double maxLagMs = 0, totalLagMs = 0;
 
-                    cout << "Enter end node: ";
-                    getline(cin, v);
-                    // Input Validation: End node cannot be empty
-                    if (v.empty()) {
-                        cout << RED << "Error: End node name cannot be empty!\n" << RESET;
-                        break;
-                    }
-                    if (u == v) {
-                        cout << RED << "Error: Start and end nodes cannot be the same for a road!\n" << RESET;
-                        break;
-                    }
+    // Replay pacing state (reader thread only)
+    bool backpressure = false; // True for regular files, which can wait instead of dropping
+    bool paced = false;
+    double firstFeedTime = 0;
+    chrono::steady_clock::time_point replayStart;
 
-                    try {
-                        cout << "Enter weight (time in seconds, e.g., 300): ";
-                        getline(cin, w_str);
-                        w_val = stoi(w_str);
-                        if (w_val <= 0) {
-                            cout << RED << "Error: Weight must be a positive integer.\n" << RESET;
-                            break;
-                        }
+    void handleLine(const string& line) {
+        if (line.empty() || line[0] == '#' || line == "\r") return;
+        FeedEvent event;
+        if (!parseFeedLine(line, event)) { ++malformed; return; }
+        if (speed > 0) { // Honour the recorded spacing of events, compressed by 'speed'
+            if (!paced) { paced = true; firstFeedTime = event.feedTime; replayStart = chrono::steady_clock::now(); }
+            auto due = replayStart + chrono::duration_cast<chrono::steady_clock::duration>(
+                chrono::duration<double>((event.feedTime - firstFeedTime) / speed));
+            while (running && chrono::steady_clock::now() < due) this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        event.receivedAt = chrono::steady_clock::now();
+        ++received;
+        // A recorded file can simply wait for the simulation to catch up; a live pipe or socket
+        // must never stall, so events that do not fit are dropped and counted.
+        while (!queue.tryPush(event)) {
+            if (!backpressure || !running) { ++dropped; return; }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
 
-                        cout << "Enter signal delay (seconds, e.g., 60): ";
-                        getline(cin, sd_str);
-                        sd_val = stoi(sd_str);
-                        if (sd_val < 0) {
-                            cout << RED << "Error: Signal delay cannot be negative.\n" << RESET;
-                            break;
-                        }
-                    } catch (const invalid_argument& e) {
-                        cout << RED << "Invalid number input. Please enter integers for weight and delay.\n" << RESET;
-                        break; // Go back to main menu
-                    } catch (const out_of_range& e) {
-                        cout << RED << "Input number out of range. Please enter smaller integers.\n" << RESET;
-                        break; // Go back to main menu
-                    }
+#ifdef _WIN32
+    void readerLoop() {
+        backpressure = true;
+        ifstream in(sourceName);
+        string line;
+        while (running && getline(in, line)) handleLine(line);
+        finishedReading = true;
+    }
+#else
+    static int openSource(const string& source) {
+        if (source.compare(0, 5, "unix:") == 0) {
+            string path = source.substr(5);
+            sockaddr_un address{};
+            if (path.size() >= sizeof(address.sun_path)) return -1;
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (sock < 0) return -1;
+            if (connect(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) { close(sock); return -1; }
+            return sock;
+        }
+        return open(source.c_str(), O_RDONLY | O_NONBLOCK); // Non-blocking so a FIFO opens without a writer
+    }
 
-                    cout << "Enter road type (General, Bike Lane, Bus Lane, Highway, Bridge, Tunnel): ";
-                    getline(cin, type);
-                    // Basic validation for road type
+    void readerLoop() {
+        struct stat info;
+        bool known = fstat(fd, &info) == 0;
+        bool isFifo = known && S_ISFIFO(info.st_mode);
+        backpressure = known && S_ISREG(info.st_mode);
+        string partial;
+        char buffer[1 << 16];
+        while (running) {
+            pollfd waiter{fd, POLLIN, 0};
+            if (poll(&waiter, 1, 100) <= 0) continue; // Wake up regularly to notice stop()
+            ssize_t n = read(fd, buffer, sizeof buffer);
+            if (n > 0) {
+                partial.append(buffer, n);
+                size_t start = 0, newline;
+                while ((newline = partial.find('\n', start)) != string::npos) {
+                    handleLine(partial.substr(start, newline - start));
+                    start = newline + 1;
+                }
+                partial.erase(0, start);
+            } else if (n == 0) {
+                if (isFifo) { this_thread::sleep_for(chrono::milliseconds(20)); continue; } // Writer may reconnect
+                if (!partial.empty()) handleLine(partial); // Last line without a newline
+                break;
+            } else if (errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+        }
+        finishedReading = true;
+    }
+#endif
+};
+
+// ================ TRIP PLAYBACK ================
+// Plays routed journeys back on the simulation clock without blocking the caller. Every trip in
+// flight is advanced by one background loop, so a route query costs only its search time and any
+// number of trips can run at once. The loop draws only the live view; arrivals are queued for the
+// menu thread so they never land in the middle of a prompt.
+class TripPlayer {
+public:
+    struct TripStatus {
+        int id;
+        string label;       // e.g. "🚗 Car: Downtown -> Airport"
+        int duration;       // Trip length in simulated seconds
+        double elapsed;     // Simulated seconds played so far
+    };
+
+    ~TripPlayer() { stop(); }
+
+    // Drives playback from advance() calls instead of the background loop, so tests can step
+    // trips deterministically. Call before the first start().
+    void useManualClock() {
+        lock_guard<mutex> lock(tripsMutex);
+        manualClock = true;
+    }
+
+    // Queues a trip for playback and returns its id.
+    int start(const string& label, int duration) {
+        lock_guard<mutex> lock(tripsMutex);
+        if (!manualClock && !worker.joinable()) {
+            running = true;
+            worker = thread(&TripPlayer::playbackLoop, this);
+        }
+        TripStatus trip = {nextId++, label, max(0, duration), 0.0};
+        trips.push_back(trip);
+        return trip.id;
+    }
+
+    bool cancel(int id) {
+        lock_guard<mutex> lock(tripsMutex);
+        for (auto it = trips.begin(); it != trips.end(); ++it) {
+            if (it->id != id) continue;
+            trips.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+    int cancelAll() {
+        lock_guard<mutex> lock(tripsMutex);
+        int cancelled = static_cast<int>(trips.size());
+        trips.clear();
+        return cancelled;
+    }
+
+    vector<TripStatus> activeTrips() const {
+        lock_guard<mutex> lock(tripsMutex);
+        return trips;
+    }
+
+    // Simulated seconds played so far; false once the trip has arrived or was cancelled.
+    bool elapsedOf(int id, double& elapsed) const {
+        lock_guard<mutex> lock(tripsMutex);
+        for (const auto& trip : trips) {
+            if (trip.id == id) { elapsed = trip.elapsed; return true; }
+        }
+        return false;
+    }
+
+    // Changes a trip's total length, e.g. after it was re-routed mid-journey.
+    bool reschedule(int id, int duration) {
+        lock_guard<mutex> lock(tripsMutex);
+        for (auto& trip : trips) {
+            if (trip.id == id) { trip.duration = max(0, duration); return true; }
+        }
+        return false;
+    }
+
+    // Live view of every trip in flight, redrawn in place by the playback loop until Enter is pressed.
+    void watch() {
+        {
+            lock_guard<mutex> lock(tripsMutex);
+            watching = true;
+            drawnLines = 0;
+        }
+        wake.notify_one();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        lock_guard<mutex> lock(tripsMutex);
+        watching = false;
+    }
+
+    void stop() {
+        {
+            lock_guard<mutex> lock(tripsMutex);
+            if (!worker.joinable()) return;
+            running = false;
+            trips.clear();
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    // Plays every trip forward by 'seconds' of simulated time (the manual clock's only driver).
+    void advance(double seconds) {
+        lock_guard<mutex> lock(tripsMutex);
+        step(seconds);
+    }
+
+    // Arrival lines not yet shown, oldest first; the menu thread prints them between prompts.
+    vector<string> takeArrivals() {
+        lock_guard<mutex> lock(tripsMutex);
+        vector<string> taken;
+        taken.swap(arrivals);
+        return taken;
+    }
+
+    void showArrivals() {
+        for (const string& line : takeArrivals()) cout << line;
+    }
+
+    void showStatus() const {
+        vector<TripStatus> snapshot = activeTrips();
+        cout << "Trips in progress: " << snapshot.size() << "\n";
+        for (const auto& trip : snapshot) printTrip(trip);
+    }
+
+    static void printTrip(const TripStatus& trip, ostream& out = cout) {
+        int percent = trip.duration > 0 ? min(100, static_cast<int>(100 * trip.elapsed / trip.duration)) : 100;
+        out << "  #" << trip.id << " " << trip.label << " " << YELLOW << progressBar(percent) << RESET
+            << " (" << max(0, trip.duration - static_cast<int>(trip.elapsed)) << "s left)\n";
+    }
+
+private:
+    mutable mutex tripsMutex;
+    condition_variable wake;
+    thread worker;
+    vector<TripStatus> trips;
+    vector<string> arrivals;  // Announcements waiting for the menu thread or the live view
+    bool running = false;
+    bool manualClock = false;
+    bool watching = false;
+    int drawnLines = 0;       // Lines drawn by the last live-view frame, erased before the next one
+    int nextId = 1;
+
+    void playbackLoop() {
+        const auto frame = chrono::milliseconds(250);
+        auto last = chrono::steady_clock::now();
+        unique_lock<mutex> lock(tripsMutex);
+        while (running) {
+            wake.wait_for(lock, frame);
+            auto now = chrono::steady_clock::now();
+            double played = chrono::duration<double>(now - last).count() * timeMultiplier.load(); // 0x pauses playback
+            last = now;
+
+            step(played);
+            if (watching) { // Only the live view draws from this thread; otherwise arrivals wait for the menu
+                string output;
+                if (drawnLines > 0) output += "\033[" + to_string(drawnLines) + "A\033[J"; // Erase the last frame
+                for (const string& line : arrivals) output += line;
+                arrivals.clear();
+                stringstream frameText;
+                frameText << CYAN << "=== TRIPS IN PROGRESS (Enter to return) ===\n" << RESET;
+                if (trips.empty()) frameText << "No trips in progress.\n";
+                for (const auto& trip : trips) printTrip(trip, frameText);
+                output += frameText.str();
+                drawnLines = 1 + static_cast<int>(max<size_t>(1, trips.size()));
+                cout << output << flush;
+            }
+        }
+    }
+
+    // Caller holds tripsMutex.
+    void step(double seconds) {
+        for (auto it = trips.begin(); it != trips.end();) {
+            it->elapsed += seconds;
+            if (it->elapsed < it->duration) { ++it; continue; }
+            arrivals.push_back(GREEN + "🏁 Trip #" + to_string(it->id) + " arrived: " + it->label
+                               + " (" + to_string(it->duration) + "s)\n" + RESET);
+            it = trips.erase(it);
+        }
+    }
+};
+
+// ================ PRIORITY QUEUES FOR ROUTING ================
+// Route costs are whole seconds and Dijkstra pops keys in non-decreasing order, so besides a
+// plain binary heap we can use monotone integer queues. All queues share one interface:
+//   reset(nodes)     prepare for a new query over 'nodes' node ids (keeps capacity)
+//   push(key, node)  insert, or lower the key of a queued node
+//   pop()            remove and return the smallest {key, node}
+// Queues without decrease-key may return stale entries; the search skips those.
+
+// std heap over a pooled vector, lazy deletion (the original behaviour)
+class BinaryHeapQueue {
+public:
+    void reset(size_t) { heap.clear(); }
+    bool empty() const { return heap.empty(); }
+
+    void push(int key, int node) {
+        heap.push_back({key, node});
+        push_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+    }
+
+    pair<int, int> pop() {
+        pop_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+        pair<int, int> top = heap.back();
+        heap.pop_back();
+        return top;
+    }
+
+private:
+    vector<pair<int, int>> heap;
+};
+
+// Indexed d-ary heap with decrease-key: each node is queued at most once
+template <int D>
+class IndexedDaryHeap {
+public:
+    void reset(size_t nodes) {
+        if (position.size() < nodes) {
+            position.resize(nodes, -1);
+            keyOf.resize(nodes);
+        }
+        for (int v : heap) position[v] = -1; // Only nodes left over from the last query
+        heap.clear();
+    }
+
+    bool empty() const { return heap.empty(); }
+
+    void push(int key, int node) {
+        int at = position[node];
+        if (at < 0) {
+            at = static_cast<int>(heap.size());
+            heap.push_back(node);
+        } else if (key >= keyOf[node]) {
+            return;
+        }
+        keyOf[node] = key;
+        siftUp(at, node);
+    }
+
+    pair<int, int> pop() {
+        int top = heap[0];
+        position[top] = -1;
+        int last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) siftDown(0, last);
+        return {keyOf[top], top};
+    }
+
+private:
+    vector<int> heap;     // Node ids in heap order
+    vector<int> position; // Index of each node in 'heap', -1 when not queued
+    vector<int> keyOf;
+
+    void place(int at, int node) { heap[at] = node; position[node] = at; }
+
+    void siftUp(int at, int node) {
+        int key = keyOf[node];
+        while (at > 0) {
+            int parent = (at - 1) / D;
+            if (keyOf[heap[parent]] <= key) break;
+            place(at, heap[parent]);
+            at = parent;
+        }
+        place(at, node);
+    }
+
+    void siftDown(int at, int node) {
+        int key = keyOf[node], size = static_cast<int>(heap.size());
+        while (true) {
+            int first = at * D + 1;
+            if (first >= size) break;
+            int best = first, bestKey = keyOf[heap[first]];
+            for (int c = first + 1; c < first + D && c < size; ++c) {
+                if (keyOf[heap[c]] < bestKey) { best = c; bestKey = keyOf[heap[c]]; }
+            }
+            if (bestKey >= key) break;
+            place(at, heap[best]);
+            at = best;
+        }
+        place(at, node);
+    }
+};
+
+// Dial's bucket queue: a circular array of buckets, one per second of cost, with intrusive
+// doubly-linked lists so decrease-key is O(1). The window grows if an edge costs more than
+// the current number of buckets, up to MAX_BUCKETS; keys beyond that wait in an overflow list
+// until the window runs dry, so one absurdly slow road cannot allocate gigabytes of buckets.
+class DialQueue {
+public:
+    static const size_t MAX_BUCKETS = 1 << 16;
+
+    DialQueue() : head(1024, -1), mask(1023) {}
+
+    void reset(size_t nodes) {
+        if (queued.size() < nodes) {
+            next.resize(nodes); prev.resize(nodes); keyOf.resize(nodes);
+            queued.resize(nodes, 0);
+        }
+        for (int v : touched) {
+            if (queued[v] == IN_WINDOW) head[keyOf[v] & mask] = -1;
+            queued[v] = 0;
+        }
+        touched.clear();
+        current = 0;
+        count = 0;
+        overflowHead = -1;
+        overflowCount = 0;
+        overflowMin = numeric_limits<int>::max();
+    }
+
+    bool empty() const { return count == 0; }
+    size_t buckets() const { return head.size(); }
+
+    void push(int key, int node) {
+        if (queued[node]) {
+            if (key >= keyOf[node]) return;
+            unlink(node);
+        } else {
+            touched.push_back(node);
+            ++count;
+        }
+        keyOf[node] = key;
+        int64_t span = static_cast<int64_t>(key) - current;
+        if (span > static_cast<int64_t>(mask) && head.size() < MAX_BUCKETS) grow(span); // Relinks every queued node
+        if (span <= static_cast<int64_t>(mask) && key < overflowMin) link(node, IN_WINDOW);
+        else link(node, IN_OVERFLOW); // Every window key stays below every overflow key
+    }
+
+    pair<int, int> pop() {
+        if (count == overflowCount) refill();
+        while (head[current & mask] < 0) ++current;
+        int node = head[current & mask];
+        unlink(node);
+        --count;
+        return {keyOf[node], node};
+    }
+
+private:
+    enum : char { IN_WINDOW = 1, IN_OVERFLOW = 2 }; // Values of 'queued'
+
+    vector<int> head;           // First node of each bucket, -1 if empty
+    vector<int> next, prev, keyOf;
+    vector<char> queued;
+    vector<int> touched;        // Nodes queued during this query, for O(touched) reset
+    size_t mask;
+    int current = 0;            // Every window key lies in [current, current + buckets)
+    size_t count = 0;
+    int overflowHead = -1;      // Keys too far ahead for the window, unordered
+    size_t overflowCount = 0;
+    int overflowMin = numeric_limits<int>::max(); // At most the smallest overflow key
+
+    int& listHead(int node) { return queued[node] == IN_OVERFLOW ? overflowHead : head[keyOf[node] & mask]; }
+
+    void link(int node, char where) {
+        queued[node] = where;
+        if (where == IN_OVERFLOW) {
+            ++overflowCount;
+            overflowMin = min(overflowMin, keyOf[node]);
+        }
+        int& first = listHead(node);
+        prev[node] = -1;
+        next[node] = first;
+        if (first >= 0) prev[first] = node;
+        first = node;
+    }
+
+    void unlink(int node) {
+        if (prev[node] >= 0) next[prev[node]] = next[node];
+        else listHead(node) = next[node];
+        if (next[node] >= 0) prev[next[node]] = prev[node];
+        if (queued[node] == IN_OVERFLOW && --overflowCount == 0) overflowMin = numeric_limits<int>::max();
+        queued[node] = 0;
+    }
+
+    void grow(int64_t span) {
+        size_t buckets = head.size();
+        while (buckets <= static_cast<uint64_t>(span) && buckets < MAX_BUCKETS) buckets <<= 1;
+        head.assign(buckets, -1);
+        mask = buckets - 1;
+        for (int v : touched) if (queued[v] == IN_WINDOW) link(v, IN_WINDOW);
+    }
+
+    // The window is empty: move it to the smallest overflow key and pull in what now fits.
+    void refill() {
+        current = numeric_limits<int>::max();
+        for (int v = overflowHead; v >= 0; v = next[v]) current = min(current, keyOf[v]);
+        overflowMin = numeric_limits<int>::max();
+        for (int v = overflowHead, after; v >= 0; v = after) {
+            after = next[v];
+            if (static_cast<int64_t>(keyOf[v]) - current <= static_cast<int64_t>(mask)) {
+                unlink(v);
+                link(v, IN_WINDOW);
+            } else {
+                overflowMin = min(overflowMin, keyOf[v]);
+            }
+        }
+    }
+};
+
+// Monotone radix heap: entries sit in bucket b when their key first differs from the last
+// popped key at bit b-1, so each entry moves down at most 32 times. Lazy deletion.
+class RadixHeapQueue {
+public:
+    void reset(size_t) {
+        for (auto& bucket : buckets) bucket.clear();
+        last = 0;
+        count = 0;
+    }
+
+    bool empty() const { return count == 0; }
+
+    void push(int key, int node) {
+        buckets[bucketFor(static_cast<uint32_t>(key))].push_back({key, node});
+        ++count;
+    }
+
+    pair<int, int> pop() {
+        if (buckets[0].empty()) {
+            int b = 1;
+            while (buckets[b].empty()) ++b;
+            uint32_t smallest = numeric_limits<uint32_t>::max();
+            for (const auto& entry : buckets[b]) smallest = min(smallest, static_cast<uint32_t>(entry.first));
+            last = smallest;
+            for (const auto& entry : buckets[b]) buckets[bucketFor(static_cast<uint32_t>(entry.first))].push_back(entry);
+            buckets[b].clear();
+        }
+        pair<int, int> top = buckets[0].back();
+        buckets[0].pop_back();
+        --count;
+        return top;
+    }
+
+private:
+    vector<pair<int, int>> buckets[33];
+    uint32_t last = 0;
+    size_t count = 0;
+
+    int bucketFor(uint32_t key) const {
+        uint32_t diff = key ^ last;
+        int bits = 0;
+        while (diff) { ++bits; diff >>= 1; }
+        return bits;
+    }
+};
+
+typedef DialQueue DefaultRouteQueue; // Fastest in the routing benchmark
+
+// One pooled queue of each type per thread
+template <class Queue>
+Queue& pooledQueue() {
+    thread_local Queue queue;
+    return queue;
+}
+
+// ================ QUERY WORKSPACE ================
+// Per-thread scratch space for route searches. Distance/parent arrays are indexed by node id and
+// reset lazily: an entry is only valid when its stamp equals the current generation, so starting
+// a query costs O(1) rather than O(nodes). Path buffers (and the pooled priority queues) keep
+// their capacity, so once warmed up a query performs no heap allocations.
+struct QueryWorkspace {
+    vector<int> dist;
+    vector<int> parentNode;
+    vector<int> parentEdge;
+    vector<uint32_t> stamp;
+    uint32_t generation = 0;
+
+    vector<int> pathNodes;         // Result of the last search, source first
+    vector<int> pathEdges;
+
+    void prepare(size_t nodes) {
+        if (stamp.size() < nodes) { // Grows only when the map grows
+            dist.resize(nodes);
+            parentNode.resize(nodes);
+            parentEdge.resize(nodes);
+            stamp.resize(nodes, 0);
+        }
+        if (++generation == 0) { // Wrapped: clear stamps once every 2^32 queries
+            fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+    }
+
+    bool reached(int v) const { return stamp[v] == generation; }
+    int distance(int v) const { return reached(v) ? dist[v] : numeric_limits<int>::max(); }
+
+    void settle(int v, int d, int fromNode, int viaEdge) {
+        stamp[v] = generation;
+        dist[v] = d;
+        parentNode[v] = fromNode;
+        parentEdge[v] = viaEdge;
+    }
+};
+
+QueryWorkspace& queryWorkspace() {
+    thread_local QueryWorkspace workspace;
+    return workspace;
+}
+
+// ================ ROUTING SNAPSHOT ================
+// Immutable copy of the routable network that any number of threads can search while the
+// simulation keeps changing the live Graph. Roads closed by a block or an incident are left
+// out, and weather and congestion are folded into each arc's cost, so the kernel reproduces
+// Graph::searchRoute exactly for the moment the snapshot was taken.
+struct RoutingSnapshot {
+    struct Arc {
+        int to;
+        int id;            // Edge id in the live graph
+        uint64_t roadBit;  // roadTypeBit() of the road type
+        double cost;       // weight * congestion factor + signal delay, before the vehicle's speed
+    };
+
+    // What an arc's cost is made of, for callers that re-cost the network (see MonteCarloRunner)
+    struct ArcTerms {
+        double baseWeight; // Weight as entered, before weather
+        int signalDelay;
+        int congestion;
+    };
+
+    // Node names and ids never change once assigned, so snapshots share one table until the
+    // graph gains a node; an update only rebuilds the arcs.
+    struct NodeTable {
+        vector<string> names;
+        unordered_map<string, int> ids;
+    };
+
+    shared_ptr<const NodeTable> nodes;
+    vector<int> firstArc;  // Arcs of node u are arcs[firstArc[u] .. firstArc[u + 1])
+    vector<Arc> arcs;
+    WeatherType weather = SUNNY;
+    uint64_t incidentVersion = 0;
+    uint64_t version = 0;  // Publication counter assigned by the owner
+
+    // Travel time to 'dest' or -1, with the path left in ws.pathNodes / ws.pathEdges. With
+    // dest == -1 the whole tree is grown instead and ws.distance() holds every travel time.
+    int search(int src, int dest, const Vehicle& vehicle, QueryWorkspace& ws) const {
+        return withVehiclePolicy(vehicle, [&](const auto& policy) { return searchKernel(src, dest, policy, ws, pooledQueue<DefaultRouteQueue>()); });
+    }
+
+    // Bounded search: every node within 'budget' seconds of src, nearest first, into 'reached',
+    // with its time in ws.distance(). Nodes outside the budget are left with tentative times.
+    void reachWithin(int src, int budget, const Vehicle& vehicle, QueryWorkspace& ws, vector<int>& reached) const {
+        withVehiclePolicy(vehicle, [&](const auto& policy) {
+            DefaultRouteQueue& queue = pooledQueue<DefaultRouteQueue>();
+            ws.prepare(nodes->names.size());
+            queue.reset(nodes->names.size());
+            reached.clear();
+            ws.settle(src, 0, -1, -1);
+            queue.push(0, src);
+            while (!queue.empty()) {
+                pair<int, int> current = queue.pop();
+                if (current.first > budget) break; // Everything left is further away
+                int u = current.second;
+                if (current.first > ws.dist[u]) continue;
+                reached.push_back(u);
+                for (int a = firstArc[u]; a < firstArc[u + 1]; ++a) {
+                    const Arc& arc = arcs[a];
+                    if ((arc.roadBit & policy.roadMask()) == 0) continue;
+                    int candidate = current.first + static_cast<int>(arc.cost / policy.speed());
+                    if (candidate < ws.distance(arc.to)) {
+                        ws.settle(arc.to, candidate, u, arc.id);
+                        queue.push(candidate, arc.to);
+                    }
+                }
+            }
+            return 0;
+        });
+    }
+
+    template <class Policy, class Queue>
+    int searchKernel(int src, int dest, const Policy& policy, QueryWorkspace& ws, Queue& queue) const {
+        ws.prepare(nodes->names.size());
+        queue.reset(nodes->names.size());
+        ws.settle(src, 0, -1, -1);
+        queue.push(0, src);
+
+        while (!queue.empty()) {
+            pair<int, int> current = queue.pop();
+            int u = current.second;
+            if (u == dest) break;
+            if (current.first > ws.dist[u]) continue; // Stale entry
+
+            for (int a = firstArc[u]; a < firstArc[u + 1]; ++a) {
+                const Arc& arc = arcs[a];
+                if ((arc.roadBit & policy.roadMask()) == 0) continue;
+                int candidate = current.first + static_cast<int>(arc.cost / policy.speed());
+                if (candidate < ws.distance(arc.to)) {
+                    ws.settle(arc.to, candidate, u, arc.id);
+                    queue.push(candidate, arc.to);
+                }
+            }
+        }
+
+        if (dest < 0) return 0;
+        if (!ws.reached(dest)) return -1;
+        ws.pathNodes.clear();
+        ws.pathEdges.clear();
+        for (int v = dest; v != src; v = ws.parentNode[v]) {
+            ws.pathNodes.push_back(v);
+            ws.pathEdges.push_back(ws.parentEdge[v]);
+        }
+        ws.pathNodes.push_back(src);
+        reverse(ws.pathNodes.begin(), ws.pathNodes.end());
+        reverse(ws.pathEdges.begin(), ws.pathEdges.end());
+        return ws.dist[dest];
+    }
+};
+
+// ================ MONTE CARLO SCENARIOS ================
+// Runs many independent what-if versions of one frozen network and reports the spread of travel
+// times per OD pair. Each run draws its own scenario (weather, rush hour or everyday congestion
+// noise, incidents) from a Xoshiro256 seeded by the master seed and the run number alone, and
+// writes into its own result slot, so a seed gives the same percentiles on any number of threads.
+class MonteCarloRunner {
+public:
+    struct Distribution {
+        string origin, destination;
+        int runs = 0;
+        int unreachable = 0;    // Runs in which incidents cut the pair off
+        bool neverReachable = false; // No route for the vehicle before any scenario is drawn; no runs were sampled
+        double mean = 0;        // Over reachable runs, seconds
+        int p10 = -1, p50 = -1, p90 = -1, p99 = -1, worst = -1;
+    };
+
+    MonteCarloRunner(shared_ptr<const RoutingSnapshot> network, vector<RoutingSnapshot::ArcTerms> arcTerms)
+        : base(move(network)), terms(move(arcTerms)) {
+        for (size_t a = 0; a < base->arcs.size(); ++a) {
+            int id = base->arcs[a].id;
+            if (static_cast<size_t>(id) >= arcOfEdge.size()) arcOfEdge.resize(id + 1, -1);
+            arcOfEdge[id] = static_cast<int>(a);
+        }
+    }
+
+    // 'runs' scenarios for every pair, spread over 'threads' workers.
+    vector<Distribution> run(const vector<pair<string, string>>& pairs, const Vehicle& vehicle, int runs,
+                             uint64_t seed, unsigned threads) const {
+        // Pairs grouped by origin, so each run grows one tree per origin
+        map<int, vector<pair<int, size_t>>> byOrigin; // origin -> [{destination, pair index}]
+        vector<Distribution> result(pairs.size());
+        for (size_t p = 0; p < pairs.size(); ++p) {
+            result[p].origin = pairs[p].first;
+            result[p].destination = pairs[p].second;
+            result[p].runs = runs;
+            auto o = base->nodes->ids.find(pairs[p].first), d = base->nodes->ids.find(pairs[p].second);
+            if (o == base->nodes->ids.end() || d == base->nodes->ids.end()) result[p].neverReachable = true;
+            else byOrigin[o->second].push_back({d->second, p});
+        }
+        // Scenarios only slow or close roads, so a pair without a route on the base network (e.g.
+        // a car to a node served only by a bus lane) is left out instead of sampled
+        QueryWorkspace& baseWs = queryWorkspace();
+        for (auto it = byOrigin.begin(); it != byOrigin.end();) {
+            base->search(it->first, -1, vehicle, baseWs);
+            auto& targets = it->second;
+            for (const auto& target : targets) result[target.second].neverReachable = !baseWs.reached(target.first);
+            targets.erase(remove_if(targets.begin(), targets.end(), [&](const pair<int, size_t>& target) { return result[target.second].neverReachable; }),
+                          targets.end());
+            it = targets.empty() ? byOrigin.erase(it) : next(it);
+        }
+        for (Distribution& d : result) if (d.neverReachable) d.runs = 0;
+
+        vector<int> samples(pairs.size() * runs, -1); // samples[p * runs + r]
+        atomic<int> nextRun{0};
+        auto worker = [&] {
+            RoutingSnapshot scenario = *base; // This worker's copy, re-costed for every run
+            QueryWorkspace& ws = queryWorkspace();
+            for (int r; (r = nextRun++) < runs;) {
+                SplitMix64 mix(seed + 0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(r));
+                Xoshiro256 rng(mix.next());
+                drawScenario(rng, scenario);
+                for (const auto& origin : byOrigin) {
+                    // A lone destination can stop the search early
+                    scenario.search(origin.first, origin.second.size() == 1 ? origin.second[0].first : -1, vehicle, ws);
+                    for (const auto& target : origin.second) {
+                        int time = ws.distance(target.first);
+                        if (time != numeric_limits<int>::max()) samples[target.second * runs + r] = time;
+                    }
+                }
+            }
+        };
+        vector<thread> pool;
+        for (unsigned t = 1; t < max(1u, threads); ++t) pool.emplace_back(worker);
+        worker();
+        for (thread& t : pool) t.join();
+
+        for (const auto& origin : byOrigin) {
+            for (const auto& target : origin.second) summarize(result[target.second], samples.begin() + target.second * runs, runs);
+        }
+        return result;
+    }
+
+    static void showReport(const vector<Distribution>& result) {
+        cout << CYAN << "\n=== MONTE CARLO TRAVEL TIMES (seconds) ===\n" << RESET << left
+             << setw(40) << "Origin -> Destination" << right << setw(8) << "p10" << setw(8) << "p50" << setw(8) << "p90"
+             << setw(8) << "p99" << setw(8) << "worst" << setw(9) << "mean" << setw(12) << "cut off\n";
+        for (const Distribution& d : result) {
+            if (d.neverReachable) {
+                cout << RED << left << setw(40) << (d.origin + " -> " + d.destination) << right << "unreachable for vehicle\n" << RESET;
+                continue;
+            }
+            string color = d.unreachable == d.runs ? RED : (d.p90 > 2 * max(1, d.p10) ? YELLOW : GREEN);
+            cout << color << left << setw(40) << (d.origin + " -> " + d.destination) << right << RESET
+                 << setw(8) << d.p10 << setw(8) << d.p50 << setw(8) << d.p90 << setw(8) << d.p99 << setw(8) << d.worst
+                 << setw(9) << fixed << setprecision(1) << d.mean << setw(10) << setprecision(1)
+                 << 100.0 * d.unreachable / max(1, d.runs) << "%\n";
+        }
+    }
+
+private:
+    shared_ptr<const RoutingSnapshot> base;
+    vector<RoutingSnapshot::ArcTerms> terms; // Indexed like base->arcs
+    vector<int> arcOfEdge;                   // Arc index of each live edge id; -1 if it is closed
+
+    // Re-costs every arc for one random scenario: weather as updateWeather picks it, rush hour in
+    // one run of four (as option 4) and everyday congestion noise otherwise, and up to three
+    // incidents (one chance in three each, as IncidentMonitor raises them) on random roads;
+    // severity 3 closes the road, lower severities add congestion.
+    void drawScenario(Xoshiro256& rng, RoutingSnapshot& net) const {
+        double weatherMult = getWeatherMultiplier(static_cast<WeatherType>(rng.below(5)));
+        bool rushHour = rng.below(4) == 0;
+        vector<int> congestion(terms.size());
+        for (size_t a = 0; a < terms.size(); ++a) {
+            int level = rushHour ? static_cast<int>(rng.below(MAX_CONGESTION)) + 1
+                                 : terms[a].congestion + static_cast<int>(rng.below(3)) - 1;
+            congestion[a] = min(MAX_CONGESTION, max(0, level));
+            net.arcs[a].roadBit = base->arcs[a].roadBit;
+        }
+        for (int i = 0; i < 3 && !terms.empty(); ++i) {
+            if (rng.below(3) != 0) continue;
+            int a = static_cast<int>(rng.below(static_cast<uint32_t>(terms.size())));
+            int severity = static_cast<int>(rng.below(3)) + 1;
+            for (int id : {base->arcs[a].id, base->arcs[a].id ^ 1}) { // Both directions of the road
+                int hit = static_cast<size_t>(id) < arcOfEdge.size() ? arcOfEdge[id] : -1;
+                if (hit < 0) continue;
+                if (severity == 3) net.arcs[hit].roadBit = 0; // No vehicle policy matches: closed
+                else congestion[hit] = min(MAX_CONGESTION, congestion[hit] + 2 * severity);
+            }
+        }
+        for (size_t a = 0; a < terms.size(); ++a) {
+            double weight = terms[a].baseWeight / weatherMult * (rushHour ? 1.5 : 1.0);
+            net.arcs[a].cost = weight * (1.0 + congestion[a] * 0.1) + terms[a].signalDelay; // As searchKernel
+        }
+    }
+
+    // Percentiles (nearest rank) of one pair's samples, in run order for a thread-independent mean.
+    static void summarize(Distribution& d, vector<int>::const_iterator first, int runs) {
+        vector<int> times;
+        double total = 0;
+        for (int r = 0; r < runs; ++r) {
+            int time = first[r];
+            if (time < 0) { ++d.unreachable; continue; }
+            times.push_back(time);
+            total += time;
+        }
+        if (times.empty()) return;
+        sort(times.begin(), times.end());
+        auto rank = [&](double q) { return times[max(0, static_cast<int>(ceil(q * times.size())) - 1)]; };
+        d.mean = total / times.size();
+        d.p10 = rank(0.10);
+        d.p50 = rank(0.50);
+        d.p90 = rank(0.90);
+        d.p99 = rank(0.99);
+        d.worst = times.back();
+    }
+};
+
+// ================ ISOCHRONES ================
+// Reachability within a travel-time budget on a RoutingSnapshot, i.e. under the weather and
+// incidents it was taken with. A single source uses a bounded Dijkstra that stops at the budget.
+// Whole-city coverage for many sources uses PHAST: a contraction hierarchy is built once per
+// snapshot and vehicle, and each source then costs one small upward search plus one linear sweep
+// over the nodes in rank order.
+struct Isochrone {
+    struct PartialRoad {
+        int from, to;     // Node ids: 'from' is within the budget, 'to' is not
+        int edgeId;
+        double fraction;  // Share of the road drivable before the budget runs out
+    };
+
+    int source = -1;
+    int budget = 0;                // Seconds
+    vector<pair<int, int>> nodes;  // {node id, seconds}, nearest first
+    vector<PartialRoad> partialRoads;
+};
+
+Isochrone computeIsochrone(const RoutingSnapshot& net, int source, int budget, const Vehicle& vehicle) {
+    Isochrone result;
+    result.source = source;
+    result.budget = budget;
+    QueryWorkspace& ws = queryWorkspace();
+    vector<int> reached;
+    net.reachWithin(source, budget, vehicle, ws, reached);
+    RuntimeVehiclePolicy policy(vehicle); // Prices arcs exactly as the search kernels do
+    for (int u : reached) {
+        result.nodes.push_back({u, ws.dist[u]});
+        for (int a = net.firstArc[u]; a < net.firstArc[u + 1]; ++a) {
+            const RoutingSnapshot::Arc& arc = net.arcs[a];
+            if ((arc.roadBit & policy.roadMask()) == 0 || ws.distance(arc.to) <= budget) continue;
+            int cost = static_cast<int>(arc.cost / policy.speed());
+            result.partialRoads.push_back({u, arc.to, arc.id, cost > 0 ? static_cast<double>(budget - ws.dist[u]) / cost : 1.0});
+        }
+    }
+    return result;
+}
+
+class ContractionHierarchy {
+public:
+    // Downward-sweep kernels of the batch sweep; every one gives the same distances.
+    enum BatchKernel { BATCH_AUTO, BATCH_SCALAR, BATCH_SSE41, BATCH_AVX2 };
+    static const int LANES = 8; // Sources per batch sweep: one AVX2 register of 32-bit distances
+
+    struct Coverage {
+        vector<int> nearest;  // Per node id: index in 'sources' of the quickest source within the budget, -1 if none
+        vector<int> time;     // Per node id: seconds from that source; ROUTE_UNREACHABLE if none
+        vector<int> reached;  // Per source: nodes within the budget
+    };
+
+    // Contracts the snapshot's network as 'vehicle' may drive it, least important nodes first.
+    ContractionHierarchy(const RoutingSnapshot& net, const Vehicle& vehicle) : n(static_cast<int>(net.nodes->names.size())) {
+        RuntimeVehiclePolicy policy(vehicle);
+        out.resize(n);
+        in.resize(n);
+        for (int u = 0; u < n; ++u) {
+            for (int a = net.firstArc[u]; a < net.firstArc[u + 1]; ++a) {
+                const RoutingSnapshot::Arc& arc = net.arcs[a];
+                if ((arc.roadBit & policy.roadMask()) != 0 && arc.to != u) addArc(u, arc.to, static_cast<int>(arc.cost / policy.speed()));
+            }
+        }
+        witnessDist.assign(n, 0);
+        witnessStamp.assign(n, 0);
+        vector<int> deletedNeighbours(n, 0), position(n, -1);
+        vector<vector<pair<int, int>>> upArcs(n), downArcs(n); // Per node: {higher node, cost}
+
+        // Lazy updates: a node's priority (edge difference plus contracted neighbours) is
+        // recomputed when it surfaces, and it goes back if it is no longer the cheapest
+        priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> order;
+        for (int v = 0; v < n; ++v) order.push({contract(v, false) - static_cast<int>(in[v].size() + out[v].size()), v});
+        int next = 0;
+        while (!order.empty()) {
+            int v = order.top().second;
+            order.pop();
+            if (position[v] >= 0) continue;
+            int priority = contract(v, false) - static_cast<int>(in[v].size() + out[v].size()) + deletedNeighbours[v];
+            if (!order.empty() && priority > order.top().first) {
+                order.push({priority, v});
+                continue;
+            }
+            contract(v, true);
+            position[v] = next++;
+            upArcs[v] = out[v];   // Every remaining neighbour is contracted later, so ranks higher
+            downArcs[v] = in[v];
+            for (const auto& arc : out[v]) { ++deletedNeighbours[arc.first]; removeArc(in[arc.first], v); }
+            for (const auto& arc : in[v]) { ++deletedNeighbours[arc.first]; removeArc(out[arc.first], v); }
+            out[v].clear();
+            in[v].clear();
+        }
+        out.clear();
+        in.clear();
+
+        // Flatten both halves by rank so the sweep walks memory in order
+        rank = position;
+        nodeAt.assign(n, 0);
+        for (int v = 0; v < n; ++v) nodeAt[rank[v]] = v;
+        upFirst.push_back(0);
+        downFirst.push_back(0);
+        for (int p = 0; p < n; ++p) {
+            for (const auto& arc : upArcs[nodeAt[p]]) up.push_back({rank[arc.first], arc.second});
+            for (const auto& arc : downArcs[nodeAt[p]]) down.push_back({rank[arc.first], arc.second});
+            upFirst.push_back(static_cast<int>(up.size()));
+            downFirst.push_back(static_cast<int>(down.size()));
+        }
+    }
+
+    size_t shortcutCount() const { return shortcuts; }
+
+    // PHAST one-to-all: travel time from 'source' to every node id, ROUTE_UNREACHABLE if none.
+    void sweep(int source, vector<int>& dist) const {
+        const vector<int>& d = sweepRanks(source);
+        dist.resize(n);
+        for (int p = 0; p < n; ++p) dist[nodeAt[p]] = d[p] >= UNREACHED ? ROUTE_UNREACHABLE : d[p];
+    }
+
+    // PHAST for many sources at once: the time from sources[i] to node v lands in
+    // dist[i * nodes + v] (ROUTE_UNREACHABLE if none). Sources go in groups of LANES: separate
+    // upward searches, then one downward sweep keeping the group's distances side by side per
+    // node, relaxed with vector adds and mins. BATCH_AUTO picks the best kernel the CPU runs.
+    void sweepBatch(const vector<int>& sources, vector<int>& dist, BatchKernel kernel = BATCH_AUTO) const {
+        dist.resize(sources.size() * n);
+        for (size_t first = 0; first < sources.size(); first += LANES) {
+            int lanes = static_cast<int>(min<size_t>(LANES, sources.size() - first));
+            const vector<int>& d = sweepLanes(&sources[first], lanes, kernel);
+            for (int p = 0; p < n; ++p) {
+                for (int lane = 0; lane < lanes; ++lane) {
+                    int time = d[p * LANES + lane];
+                    dist[(first + lane) * n + nodeAt[p]] = time >= UNREACHED ? ROUTE_UNREACHABLE : time;
+                }
+            }
+        }
+    }
+
+    static BatchKernel bestKernel() {
+        static const BatchKernel best = [] {
+#ifdef X86_SIMD
+            if (__builtin_cpu_supports("avx2")) return BATCH_AVX2;
+            if (__builtin_cpu_supports("sse4.1")) return BATCH_SSE41;
+#endif
+            return BATCH_SCALAR;
+        }();
+        return best;
+    }
+
+    static const char* kernelName(BatchKernel kernel) {
+        switch (kernel) {
+            case BATCH_AVX2:  return "AVX2";
+            case BATCH_SSE41: return "SSE4.1";
+            case BATCH_SCALAR: return "Scalar";
+            default:          return kernelName(bestKernel());
+        }
+    }
+
+    // Quickest source within 'budget' seconds for every node, sweeping groups of sources on
+    // 'threads' workers. Ties go to the earlier source, so the map does not depend on the
+    // thread count.
+    Coverage coverage(const vector<int>& sources, int budget, unsigned threads) const {
+        Coverage result;
+        result.reached.assign(sources.size(), 0);
+        size_t groups = (sources.size() + LANES - 1) / LANES;
+        threads = max(1u, min(threads, static_cast<unsigned>(max<size_t>(1, groups))));
+        vector<vector<int>> bestTime(threads, vector<int>(n, UNREACHED)), bestSource(threads, vector<int>(n, -1));
+        atomic<size_t> nextGroup{0};
+        auto worker = [&](unsigned t) {
+            for (size_t g; (g = nextGroup++) < groups;) {
+                size_t first = g * LANES;
+                int lanes = static_cast<int>(min<size_t>(LANES, sources.size() - first));
+                const vector<int>& d = sweepLanes(&sources[first], lanes, BATCH_AUTO);
+                for (int lane = 0; lane < lanes; ++lane) {
+                    int i = static_cast<int>(first) + lane, reached = 0;
+                    for (int p = 0; p < n; ++p) {
+                        int time = d[p * LANES + lane];
+                        if (time > budget) continue;
+                        ++reached;
+                        if (time < bestTime[t][p] || (time == bestTime[t][p] && i < bestSource[t][p])) {
+                            bestTime[t][p] = time;
+                            bestSource[t][p] = i;
+                        }
+                    }
+                    result.reached[i] = reached;
+                }
+            }
+        };
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+        worker(0);
+        for (thread& t : pool) t.join();
+
+        result.nearest.assign(n, -1);
+        result.time.assign(n, ROUTE_UNREACHABLE);
+        for (int p = 0; p < n; ++p) {
+            int time = UNREACHED, source = -1;
+            for (unsigned t = 0; t < threads; ++t) {
+                if (bestTime[t][p] < time || (bestTime[t][p] == time && bestSource[t][p] >= 0 && bestSource[t][p] < source)) {
+                    time = bestTime[t][p];
+                    source = bestSource[t][p];
+                }
+            }
+            if (source < 0) continue;
+            result.nearest[nodeAt[p]] = source;
+            result.time[nodeAt[p]] = time;
+        }
+        return result;
+    }
+
+private:
+    static const int UNREACHED = numeric_limits<int>::max() / 2; // Headroom so d + cost cannot overflow
+    static const int WITNESS_SETTLE_LIMIT = 500;
+
+    int n;
+    size_t shortcuts = 0;
+    vector<int> rank, nodeAt;                   // Node id -> rank (contraction order) and back
+    vector<int> upFirst, downFirst;             // By rank: arcs[first[p] .. first[p + 1])
+    vector<pair<int, int>> up;                  // {higher rank, cost} leaving rank p
+    vector<pair<int, int>> down;                // {higher rank, cost} arriving at rank p
+
+    // Contraction state
+    vector<vector<pair<int, int>>> out, in;     // Remaining graph: {neighbour, cost}
+    vector<int> witnessDist, witnessStamp;
+    int witnessGeneration = 0;
+    BinaryHeapQueue witnessQueue;
+
+    void addArc(int u, int v, int cost) {
+        for (auto& arc : out[u]) {
+            if (arc.first != v) continue;
+            if (cost < arc.second) {
+                arc.second = cost;
+                for (auto& back : in[v]) if (back.first == u) back.second = cost;
+            }
+            return;
+        }
+        out[u].push_back({v, cost});
+        in[v].push_back({u, cost});
+    }
+
+    static void removeArc(vector<pair<int, int>>& arcs, int neighbour) {
+        arcs.erase(remove_if(arcs.begin(), arcs.end(), [&](const pair<int, int>& arc) { return arc.first == neighbour; }), arcs.end());
+    }
+
+    // Shortcuts needed to contract v (added when 'apply'): for each pair of neighbours u -> v -> w
+    // with no path of at most the same cost that avoids v.
+    int contract(int v, bool apply) {
+        int needed = 0;
+        for (const auto& from : in[v]) { // Shortcuts never touch v's own lists
+            int limit = 0;
+            for (const auto& to : out[v]) limit = max(limit, from.second + to.second);
+            witnessSearch(from.first, v, limit);
+            for (const auto& to : out[v]) {
+                if (to.first == from.first) continue;
+                int cost = from.second + to.second;
+                if (witnessStamp[to.first] == witnessGeneration && witnessDist[to.first] <= cost) continue;
+                ++needed;
+                if (apply) {
+                    addArc(from.first, to.first, cost);
+                    ++shortcuts;
+                }
+            }
+        }
+        return needed;
+    }
+
+    // Bounded Dijkstra from 'source' over the remaining graph without 'skip'.
+    void witnessSearch(int source, int skip, int limit) {
+        ++witnessGeneration;
+        witnessQueue.reset(n);
+        witnessStamp[source] = witnessGeneration;
+        witnessDist[source] = 0;
+        witnessQueue.push(0, source);
+        for (int settled = 0; !witnessQueue.empty() && settled < WITNESS_SETTLE_LIMIT; ++settled) {
+            pair<int, int> current = witnessQueue.pop();
+            int u = current.second;
+            if (current.first > witnessDist[u]) continue;
+            if (current.first > limit) break;
+            for (const auto& arc : out[u]) {
+                if (arc.first == skip) continue;
+                int candidate = current.first + arc.second;
+                if (witnessStamp[arc.first] != witnessGeneration || candidate < witnessDist[arc.first]) {
+                    witnessStamp[arc.first] = witnessGeneration;
+                    witnessDist[arc.first] = candidate;
+                    witnessQueue.push(candidate, arc.first);
+                }
+            }
+        }
+    }
+
+    // Upward search from the source, then one pass over all ranks from the top down; leaves the
+    // times by rank in the calling thread's buffer.
+    const vector<int>& sweepRanks(int source) const {
+        thread_local vector<int> d;
+        thread_local BinaryHeapQueue queue;
+        d.assign(n, UNREACHED);
+        queue.reset(n);
+        d[rank[source]] = 0;
+        queue.push(0, rank[source]);
+        while (!queue.empty()) {
+            pair<int, int> current = queue.pop();
+            int p = current.second;
+            if (current.first > d[p]) continue;
+            for (int k = upFirst[p]; k < upFirst[p + 1]; ++k) {
+                int candidate = current.first + up[k].second;
+                if (candidate < d[up[k].first]) {
+                    d[up[k].first] = candidate;
+                    queue.push(candidate, up[k].first);
+                }
+            }
+        }
+        for (int p = n - 1; p >= 0; --p) {
+            int best = d[p];
+            for (int k = downFirst[p]; k < downFirst[p + 1]; ++k) best = min(best, d[down[k].first] + down[k].second);
+            d[p] = best;
+        }
+        return d;
+    }
+
+    // sweepRanks for up to LANES sources: times by rank and lane at d[rank * LANES + lane].
+    const vector<int>& sweepLanes(const int* sources, int lanes, BatchKernel kernel) const {
+        thread_local vector<int> d;
+        thread_local BinaryHeapQueue queue;
+        d.assign(static_cast<size_t>(n) * LANES, UNREACHED);
+        for (int lane = 0; lane < lanes; ++lane) { // Upward searches are small; one lane at a time
+            queue.reset(n);
+            d[rank[sources[lane]] * LANES + lane] = 0;
+            queue.push(0, rank[sources[lane]]);
+            while (!queue.empty()) {
+                pair<int, int> current = queue.pop();
+                int p = current.second;
+                if (current.first > d[p * LANES + lane]) continue;
+                for (int k = upFirst[p]; k < upFirst[p + 1]; ++k) {
+                    int candidate = current.first + up[k].second;
+                    int& slot = d[up[k].first * LANES + lane];
+                    if (candidate < slot) {
+                        slot = candidate;
+                        queue.push(candidate, up[k].first);
+                    }
+                }
+            }
+        }
+        if (kernel == BATCH_AUTO) kernel = bestKernel();
+#ifdef X86_SIMD
+        if (kernel == BATCH_AVX2) { downSweepAvx2(d.data()); return d; }
+        if (kernel == BATCH_SSE41) { downSweepSse41(d.data()); return d; }
+#endif
+        downSweepScalar(d.data());
+        return d;
+    }
+
+    void downSweepScalar(int* d) const {
+        for (int p = n - 1; p >= 0; --p) {
+            int* best = d + p * LANES;
+            for (int k = downFirst[p]; k < downFirst[p + 1]; ++k) {
+                const int* from = d + down[k].first * LANES;
+                int cost = down[k].second;
+                for (int lane = 0; lane < LANES; ++lane) best[lane] = min(best[lane], from[lane] + cost);
+            }
+        }
+    }
+
+#ifdef X86_SIMD
+    __attribute__((target("avx2")))
+    void downSweepAvx2(int* d) const {
+        for (int p = n - 1; p >= 0; --p) {
+            __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + p * LANES));
+            for (int k = downFirst[p]; k < downFirst[p + 1]; ++k) {
+                __m256i from = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + down[k].first * LANES));
+                best = _mm256_min_epi32(best, _mm256_add_epi32(from, _mm256_set1_epi32(down[k].second)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + p * LANES), best);
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    void downSweepSse41(int* d) const { // Two registers of four lanes
+        for (int p = n - 1; p >= 0; --p) {
+            __m128i* target = reinterpret_cast<__m128i*>(d + p * LANES);
+            __m128i low = _mm_loadu_si128(target), high = _mm_loadu_si128(target + 1);
+            for (int k = downFirst[p]; k < downFirst[p + 1]; ++k) {
+                const __m128i* from = reinterpret_cast<const __m128i*>(d + down[k].first * LANES);
+                __m128i cost = _mm_set1_epi32(down[k].second);
+                low = _mm_min_epi32(low, _mm_add_epi32(_mm_loadu_si128(from), cost));
+                high = _mm_min_epi32(high, _mm_add_epi32(_mm_loadu_si128(from + 1), cost));
+            }
+            _mm_storeu_si128(target, low);
+            _mm_storeu_si128(target + 1, high);
+        }
+    }
+#endif
+};
+
+const int ContractionHierarchy::UNREACHED;
+const int ContractionHierarchy::LANES;
+
+void showIsochrone(const RoutingSnapshot& net, const Isochrone& iso) {
+    const size_t shown = 40;
+    cout << CYAN << "\n=== ISOCHRONE: " << net.nodes->names[iso.source] << " within " << iso.budget << "s ===\n" << RESET;
+    cout << BOLD << iso.nodes.size() << " node(s) reachable:\n" << RESET;
+    for (size_t i = 0; i < iso.nodes.size() && i < shown; ++i) {
+        cout << "  " << GREEN << setw(6) << iso.nodes[i].second << "s  " << RESET << net.nodes->names[iso.nodes[i].first] << "\n";
+    }
+    if (iso.nodes.size() > shown) cout << "  ... and " << iso.nodes.size() - shown << " more\n";
+    cout << BOLD << iso.partialRoads.size() << " road(s) partly reachable:\n" << RESET;
+    for (size_t i = 0; i < iso.partialRoads.size() && i < shown; ++i) {
+        const Isochrone::PartialRoad& road = iso.partialRoads[i];
+        cout << "  " << YELLOW << setw(5) << static_cast<int>(road.fraction * 100) << "%  " << RESET
+             << net.nodes->names[road.from] << " -> " << net.nodes->names[road.to] << "\n";
+    }
+    if (iso.partialRoads.size() > shown) cout << "  ... and " << iso.partialRoads.size() - shown << " more\n";
+}
+
+void showCoverage(const RoutingSnapshot& net, const vector<int>& sources, const ContractionHierarchy::Coverage& coverage, int budget) {
+    cout << CYAN << "\n=== COVERAGE WITHIN " << budget << "s ===\n" << RESET;
+    vector<int> nearestCount(sources.size(), 0), uncovered;
+    for (size_t v = 0; v < coverage.nearest.size(); ++v) {
+        if (coverage.nearest[v] >= 0) ++nearestCount[coverage.nearest[v]];
+        else uncovered.push_back(static_cast<int>(v));
+    }
+    cout << left << setw(28) << "Source" << setw(12) << "Reaches" << "Quickest for\n" << right;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        cout << left << setw(28) << net.nodes->names[sources[i]] << setw(12) << coverage.reached[i] << nearestCount[i] << "\n" << right;
+    }
+    size_t covered = coverage.nearest.size() - uncovered.size();
+    cout << (uncovered.empty() ? GREEN : YELLOW) << "Covered: " << covered << " of " << coverage.nearest.size() << " nodes\n" << RESET;
+    for (size_t i = 0; i < uncovered.size() && i < 20; ++i) cout << "  " << RED << "⛔ " << RESET << net.nodes->names[uncovered[i]] << "\n";
+    if (uncovered.size() > 20) cout << "  ... and " << uncovered.size() - 20 << " more\n";
+}
+
+// ================ GRAPH CLASS ================
+class Graph {
+    friend class ShardCoordinator; // Routes over the roads between shards of this graph
+
+private:
+    struct Edge {
+        string destination;
+        double weight;       // Changed to double for weather multipliers to retain precision
+        int signalDelay;
+        bool blocked;        // Can be set by incidents or manually
+        int congestion;      // Level of congestion (0-MAX_CONGESTION)
+        string roadType;     // Type of road: General, Highway, Bike Lane, etc.
+        int id;              // Dense directed-edge id (the reverse road is id ^ 1)
+        int to;              // Dense node id of 'destination'
+        double baseWeight;   // Weight as entered, before weather, rush hour or assignment
+        int roadTypeId;      // roadTypeId(roadType), for allocation-free permission checks
+        double flow;         // Assigned volume (vehicles/hour) from the last traffic assignment
+        uint64_t roadBit;    // roadTypeBit(roadTypeId), tested against a vehicle policy's road mask
+
+        Edge() : destination(""), weight(0.0), signalDelay(0), blocked(false), congestion(0), roadType("General"), id(-1), to(-1), baseWeight(0.0), roadTypeId(0), flow(0.0), roadBit(roadTypeBit(0)) {}
+        Edge(const string& d, double w, int sd, string rt = "General")
+            : destination(d), weight(w), signalDelay(sd), blocked(false), congestion(0), roadType(rt), id(-1), to(-1), baseWeight(w), roadTypeId(::roadTypeId(rt)), flow(0.0), roadBit(roadTypeBit(roadTypeId)) {}
+    };
+
+    map<string, vector<Edge>> adjList;
+    // Store original edge properties separately to re-apply effects consistently
+    // This map stores the 'base' properties of each road segment, without temporary effects.
+    map<pair<string, string>, Edge> baseEdges; // Key is {source, destination} to identify unique roads
+
+    // Dense node ids so numeric kernels can work on flat arrays instead of string-keyed maps.
+    unordered_map<string, int> nodeIds;
+    vector<string> nodeNames;            // nodeNames[id] is the node's name
+    vector<vector<Edge>*> nodeEdges;     // nodeEdges[id] points into adjList (std::map nodes never move)
+    vector<string> nodeAreas;            // getRoadTypeDisplayName() of each node, used by incident checks
+    vector<pair<int, int>> edgeSlots;    // Edge id -> {node id, index in that node's edge list}
+    int edgeCount = 0;                   // Number of directed edges handed out so far
+    vector<EdgeHistory> edgeHistory;     // Observation history per edge id
+    vector<uint8_t> incidentClosed;      // 1 when an active incident closes the edge (see refreshIncidentClosures)
+    uint64_t closuresVersion = ~0ULL;    // IncidentMonitor::version() incidentClosed was built from
+    shared_ptr<const RoutingSnapshot::NodeTable> snapshotNodes; // Node tables shared by snapshots until a node is added
+
+    int internNode(const string& name) {
+        auto it = nodeIds.find(name);
+        if (it != nodeIds.end()) return it->second;
+        int id = static_cast<int>(nodeNames.size());
+        nodeIds[name] = id;
+        nodeNames.push_back(name);
+        snapshotNodes.reset(); // The next snapshot copies the grown tables
+        nodeEdges.push_back(&adjList[name]);
+        nodeAreas.push_back(getRoadTypeDisplayName(name));
+        return id;
+    }
+
+    Edge& edgeById(int id) {
+        const pair<int, int>& slot = edgeSlots[id];
+        return (*nodeEdges[slot.first])[slot.second];
+    }
+
+    int appliedWeather = -1; // Weather currently baked into edge weights; -1 when weights were changed otherwise
+
+    // IncidentMonitor is now a Singleton, access via getInstance()
+    // IncidentMonitor monitor; // No longer needed as a member variable
+
+    AIOptimizer ai;
+    TelemetryExporter telemetry;
+    FeedIngestor feed;
+    vector<FeedEvent> feedBatch; // Reused between batches
+    TripPlayer trips;            // Journeys being played back on the simulation clock
+
+    // A trip in flight, kept re-routable: a shortest-path tree towards its destination (over
+    // reversed edges, so any position on the way can be re-planned) plus the plan being followed.
+    struct RouteSubscription {
+        int trip;
+        int dest;
+        RuntimeVehiclePolicy policy;
+        string label;
+        vector<int> cost;          // Vehicle travel time per edge id; ROUTE_UNREACHABLE if it may not be used
+        vector<int> dist;          // Time from each node to 'dest'
+        vector<int> nextNode;      // Next node towards 'dest' (-1 at dest or when cut off)
+        vector<int> nextEdge;      // Edge id from the node to nextNode
+        vector<int> planNodes;     // Route currently being driven, from the last re-plan point
+        vector<int> planArrival;   // Seconds after planStart at which each plan node is reached
+        double planStart;          // Trip time at which planNodes[0] is reached
+        bool stranded;             // No route left; reported once
+
+        RouteSubscription(int id, int destination, const Vehicle& vehicle)
+            : trip(id), dest(destination), policy(vehicle), planStart(0), stranded(false) {}
+    };
+
+    map<int, RouteSubscription> subscriptions; // By trip id
+    vector<double> watchedCost;  // Vehicle-independent cost per edge at the last refresh; -1 when closed
+    int watchedWeather = -1;     // Weather seen by the last refresh
+    int reroutes = 0, treeRepairs = 0;
+    vector<string> rerouteNotices; // Re-route lines not yet shown; guarded by simulationMutex
+    mutex simulationMutex;       // Held by the menu while it works, so the re-routing watcher can run between inputs
+
+    unique_ptr<ContractionHierarchy> batchHierarchy; // Kept by batchShortestPaths while the network stays the same
+    uint64_t batchKey = 0;                           // Fingerprint of the network and vehicle it was built for
+
+public:
+    // ================ ENHANCED VISUALIZATION ================
+    void showEnhancedMap() {
+        cout << CYAN << "\n🌍 LIVE TRAFFIC MAP 🌍\n" << RESET;
+        if (adjList.empty()) {
+            cout << "Map is empty. Please add some roads first (Option 1).\n";
+            return;
+        }
+        for (auto& node : adjList) {
+            cout << BOLD << "🟢 " << node.first << RESET << " [" << getRoadTypeDisplayName(node.first) << "]\n";
+            for (auto& edge : node.second) {
+                // Determine color based on status
+                string statusColor = edge.blocked ? RED : GREEN;
+                string emojiStatus = edge.blocked ? "⛔" : "✅";
+                string congestionInfo = "";
+                if (edge.congestion > 0) {
+                    congestionInfo = YELLOW + " (" + to_string(edge.congestion) + " cars)" + RESET;
+                }
+
+                cout << "    " << emojiStatus << statusColor << " " << edge.destination << RESET << " ("
+                     << fixed << setprecision(0) << edge.weight << "s, " << edge.roadType << ")"
+                     << congestionInfo << "\n";
+            }
+        }
+    }
+
+    // Helper to get a nicer display name for road types (could be improved to use enums)
+    string getRoadTypeDisplayName(const string& node) {
+        if (node.find("Highway") != string::npos) return "Highway";
+        if (node.find("Bridge") != string::npos) return "Bridge";
+        if (node.find("Bike") != string::npos) return "Bike Lane";
+        if (node.find("Bus") != string::npos) return "Bus Lane";
+        if (node.find("Tunnel") != string::npos) return "Tunnel";
+        if (node.find("Airport") != string::npos) return "Airport Access";
+        if (node.find("Hospital") != string::npos) return "Hospital Access";
+        return "General";
+    }
+
+    // ================ EMERGENCY SYSTEM ================
+    void playSiren() {
+#ifdef _WIN32 // Conditionally compile Beep for Windows
+        // Beep frequency and duration adjustments for a more "siren-like" sound
+        for (int i = 0; i < 3; ++i) { // Repeat a few times
+            Beep(600, 150); // Lower tone
+            Beep(900, 150); // Higher tone
+            Beep(600, 150);
+            Beep(900, 150);
+            Sleep(100); // Short pause between cycles
+        }
+#endif
+        cout << EMERGENCY_COLOR << "\n🚨 ALL VEHICLES YIELD TO EMERGENCY VEHICLE! 🚨\n" << RESET;
+    }
+
+    // ================ ROAD MANAGEMENT ================
+    void addRoad(const string& u, const string& v, int w, int sd, string roadType = "General", bool announce = true) {
+        int uid = internNode(u), vid = internNode(v);
+        // Add road in both directions for a bidirectional graph
+        Edge forward(v, w, sd, roadType), backward(u, w, sd, roadType);
+        forward.id = edgeCount++; forward.to = vid;
+        backward.id = edgeCount++; backward.to = uid;
+        edgeSlots.push_back({uid, static_cast<int>(adjList[u].size())});
+        adjList[u].push_back(forward);
+        edgeSlots.push_back({vid, static_cast<int>(adjList[v].size())});
+        adjList[v].push_back(backward);
+        edgeHistory.resize(edgeCount);
+        incidentClosed.resize(edgeCount, 0);
+        closuresVersion = ~0ULL; // Re-check incidents against the new edges
+        appliedWeather = -1; // New roads carry their raw weight
+        // Store original edge properties for later use (e.g., reverting rush hour effects, weather)
+        baseEdges[{u, v}] = Edge(v, w, sd, roadType);
+        baseEdges[{v, u}] = Edge(u, w, sd, roadType);
+        if (announce) cout << GREEN << "Road added: " << u << " <-> " << v << " (" << roadType << ")\n" << RESET;
+    }
+
+    // ================ FUEL & ENVIRONMENT STATS ================
+    // Simplified CO2 calculation (approximate, kg per 1000 units of distance)
+    static double co2PerDistance(const Vehicle& vehicle) {
+        double co2PerDistanceUnit = 0.12; // Base kg CO2 per distance unit (e.g., meter)
+        if (vehicle.type == BUS) co2PerDistanceUnit *= 2.5; // Buses produce more CO2
+        else if (vehicle.type == BIKE) co2PerDistanceUnit = 0; // Bikes are zero emission
+        return co2PerDistanceUnit;
+    }
+
+    void showEcoStats(const Vehicle& vehicle, double distance) {
+        double co2PerDistanceUnit = co2PerDistance(vehicle);
+
+        // Fuel efficiency as "units of distance per fuel unit" (inverse of fuelRate)
+        double fuelEfficiency = (vehicle.fuelRate > 0) ? (1.0 / vehicle.fuelRate) : 0; // Higher value is better
+
+        cout << GREEN << "♻️ Eco Stats for " << vehicle.name << " journey:\n"
+             << "   CO2 Emission: " << fixed << setprecision(2) << distance * co2PerDistanceUnit << " kg\n"
+             << "   Relative Fuel Efficiency: " << fixed << setprecision(2) << fuelEfficiency << " units/fuel unit\n" << RESET;
+    }
+
+    // ================ TOLL SYSTEM ================
+    int getTollFee(const string& roadType) {
+        static map<string, int> tolls = {
+            {"Highway", 5}, {"Bridge", 3}, {"Tunnel", 7}
+        };
+        return tolls.count(roadType) ? tolls.at(roadType) : 0; // Use .at() for const correctness
+    }
+
+    // ================ SHORTEST PATH WITH ALL FEATURES ================
+    // A computed route: node ids in travel order and the ids of the edges between them.
+    struct Route {
+        int totalTime = 0;
+        vector<int> nodes;
+        vector<int> edgeIds;
+    };
+
+    // Dijkstra search honouring incidents, blocked roads, vehicle permissions, congestion and
+    // weather. Prints nothing; returns false when the destination is unreachable. Reusing the
+    // same Route object across calls keeps steady-state queries allocation-free.
+    bool computeRoute(const string& src, const string& dest, const Vehicle& vehicle, Route& route) {
+        applyFeedEvents(); // Route against the latest reported incidents and closures
+        refreshIncidentClosures();
+        // Apply weather effects just before pathfinding starts, ensuring current conditions apply
+        applyWeatherEffects();
+
+        auto from = nodeIds.find(src), to = nodeIds.find(dest);
+        if (from == nodeIds.end() || to == nodeIds.end()) return false;
+
+        QueryWorkspace& ws = queryWorkspace();
+        int totalTime = searchRoute(from->second, to->second, vehicle, ws);
+        if (totalTime < 0) return false;
+        route.totalTime = totalTime;
+        route.nodes.assign(ws.pathNodes.begin(), ws.pathNodes.end());
+        route.edgeIds.assign(ws.pathEdges.begin(), ws.pathEdges.end());
+        return true;
+    }
+
+    // Folds the active incidents into one flag per edge, so the search kernel tests a byte instead
+    // of doing string lookups per relaxed edge. Only rebuilt when the incident set or the road
+    // network changed; call it from the thread that owns the graph before searching.
+    void refreshIncidentClosures() {
+        const IncidentMonitor& monitor = IncidentMonitor::getInstance();
+        if (closuresVersion == monitor.version()) return;
+        for (size_t u = 0; u < nodeEdges.size(); ++u) {
+            for (const Edge& edge : *nodeEdges[u]) {
+                incidentClosed[edge.id] = monitor.blocksRoad(nodeNames[u], edge.destination, nodeAreas[u], edge.roadType);
+            }
+        }
+        closuresVersion = monitor.version();
+    }
+
+    // Initial map for the non-interactive modes: the default roads, or a side x side grid city.
+    void loadMap(int gridSide) {
+        if (gridSide > 1) addGridCity(gridSide, 42);
+        else addDefaultRoads();
+    }
+
+    // Freezes the current routable network (latest feed events, incidents and weather applied)
+    // into a RoutingSnapshot that other threads can search without touching this graph. With
+    // 'terms', the parts of each arc's cost are also returned, indexed like snapshot->arcs.
+    shared_ptr<RoutingSnapshot> makeSnapshot(vector<RoutingSnapshot::ArcTerms>* terms = nullptr) {
+        applyFeedEvents();
+        refreshIncidentClosures();
+        applyWeatherEffects();
+
+        auto snapshot = make_shared<RoutingSnapshot>();
+        if (!snapshotNodes) {
+            auto table = make_shared<RoutingSnapshot::NodeTable>();
+            table->names = nodeNames;
+            table->ids = nodeIds;
+            snapshotNodes = table;
+        }
+        snapshot->nodes = snapshotNodes;
+        snapshot->firstArc.reserve(nodeNames.size() + 1);
+        snapshot->arcs.reserve(edgeCount);
+        if (terms) terms->clear();
+        for (size_t u = 0; u < nodeEdges.size(); ++u) {
+            snapshot->firstArc.push_back(static_cast<int>(snapshot->arcs.size()));
+            for (const Edge& edge : *nodeEdges[u]) {
+                if (edge.blocked || incidentClosed[edge.id]) continue;
+                double effectiveWeight = edge.weight * (1.0 + (edge.congestion * 0.1)); // Same cost as searchKernel
+                snapshot->arcs.push_back({edge.to, edge.id, edge.roadBit, effectiveWeight + edge.signalDelay});
+                if (terms) terms->push_back({edge.baseWeight, edge.signalDelay, edge.congestion});
+            }
+        }
+        snapshot->firstArc.push_back(static_cast<int>(snapshot->arcs.size()));
+        snapshot->weather = currentWeather;
+        snapshot->incidentVersion = IncidentMonitor::getInstance().version();
+        return snapshot;
+    }
+
+    // Core search on dense ids using the calling thread's pooled default queue.
+    int searchRoute(int src, int dest, const Vehicle& vehicle, QueryWorkspace& ws) {
+        return searchRoute(src, dest, vehicle, ws, pooledQueue<DefaultRouteQueue>());
+    }
+
+    // Core search on dense ids with a caller-provided workspace and priority queue. Returns the
+    // travel time to 'dest', or -1 if it is unreachable; the path is left in ws.pathNodes /
+    // ws.pathEdges. Stock vehicles are dispatched to a kernel specialised on their compile-time
+    // policy; a vehicle whose speed or permissions differ from its stock type uses the runtime one.
+    template <class Queue>
+    int searchRoute(int src, int dest, const Vehicle& vehicle, QueryWorkspace& ws, Queue& queue) {
+        return withVehiclePolicy(vehicle, [&](const auto& policy) { return searchKernel(src, dest, policy, ws, queue); });
+    }
+
+    // Dijkstra kernel shared by every vehicle policy. With a VehiclePolicy the road mask and speed
+    // are constants, so the permission test is a single AND against an immediate.
+    template <class Policy, class Queue>
+    int searchKernel(int src, int dest, const Policy& policy, QueryWorkspace& ws, Queue& queue) {
+        ws.prepare(nodeNames.size());
+        queue.reset(nodeNames.size());
+        ws.settle(src, 0, -1, -1); // Distance to source is 0
+        queue.push(0, src);        // Start Dijkstra's from source
+
+        while (!queue.empty()) {
+            pair<int, int> current = queue.pop();
+            int u = current.second;
+            if (u == dest) break; // Found the destination, can stop early
+            if (current.first > ws.dist[u]) continue; // Stale entry: already found a shorter path to 'u'
+
+            for (const Edge& edge : *nodeEdges[u]) {
+                // Skip blocked roads, roads closed by an incident and roads not allowed for this
+                // vehicle; the three tests are combined so there is one branch per edge
+                bool usable = ((edge.roadBit & policy.roadMask()) != 0) & !edge.blocked & !incidentClosed[edge.id];
+                if (!usable) continue;
+
+                // Calculate total time cost for this segment
+                double effectiveWeight = edge.weight; // Base weight already adjusted by weather
+                effectiveWeight *= (1.0 + (edge.congestion * 0.1)); // Add 10% delay per congestion unit
+                int timeCost = static_cast<int>((effectiveWeight + edge.signalDelay) / policy.speed());
+
+                int candidate = current.first + timeCost;
+                if (candidate < ws.distance(edge.to)) {
+                    ws.settle(edge.to, candidate, u, edge.id);
+                    queue.push(candidate, edge.to);
+                }
+            }
+        }
+
+        if (dest < 0) return 0; // Full tree requested: distances are left in ws
+        if (!ws.reached(dest)) return -1;
+
+        // Reconstruct the path into the workspace buffers
+        ws.pathNodes.clear();
+        ws.pathEdges.clear();
+        for (int v = dest; v != src; v = ws.parentNode[v]) {
+            ws.pathNodes.push_back(v);
+            ws.pathEdges.push_back(ws.parentEdge[v]);
+        }
+        ws.pathNodes.push_back(src);
+        reverse(ws.pathNodes.begin(), ws.pathNodes.end()); // Reverse to get path from source to destination
+        reverse(ws.pathEdges.begin(), ws.pathEdges.end());
+        return ws.dist[dest];
+    }
+
+    void shortestPath(const string& src, const string& dest, Vehicle vehicle) {
+        // Edge Case Check: Source and destination are identical
+        if (src == dest) {
+            cout << RED << "Error: Source and destination are identical! No route needed.\n" << RESET;
+            return;
+        }
+
+        // Edge Case Check: Source or destination node doesn't exist
+        if (adjList.find(src) == adjList.end()) {
+            cout << RED << "Error: Source node '" << src << "' doesn't exist in the map!\n" << RESET;
+            return;
+        }
+        if (adjList.find(dest) == adjList.end()) {
+            cout << RED << "Error: Destination node '" << dest << "' doesn't exist in the map!\n" << RESET;
+            return;
+        }
+
+        // Performance Metrics: Start timer
+        auto start_time = chrono::high_resolution_clock::now();
+
+        if (vehicle.emergency) playSiren();
+
+        Route route;
+        bool found = computeRoute(src, dest, vehicle, route);
+
+        // Performance Metrics: End timer and display duration
+        auto end_time = chrono::high_resolution_clock::now();
+        cout << "Route calculation took: "
+             << chrono::duration_cast<chrono::milliseconds>(end_time-start_time).count()
+             << "ms\n";
+
+        if (!found) {
+            cout << RED << "No path exists from " << src << " to " << dest << " for " << vehicle.name << "!\n" << RESET;
+            return;
+        }
+
+        cout << GREEN << "\nRoute for " << vehicle.emoji << " " << vehicle.name << ":\n" << RESET;
+        double totalDistance = 0;
+        int totalToll = 0;
+
+        for (size_t i = 0; i < route.nodes.size(); ++i) {
+            cout << BOLD << nodeNames[route.nodes[i]] << RESET;
+            if (i < route.edgeIds.size()) {
+                const Edge& edge = edgeById(route.edgeIds[i]);
+                // Use the original base weight for total distance calculation (not affected by weather/congestion)
+                totalDistance += edge.baseWeight;
+
+                int toll = getTollFee(edge.roadType); // Get toll based on road type
+                if (toll > 0) {
+                    cout << YELLOW << " [Toll: $" << toll << "]" << RESET;
+                    totalToll += toll;
+                }
+                cout << " -> ";
+            }
+        }
+        cout << "\n⏱️ Total time: " << route.totalTime << "s";
+        if (totalToll > 0) {
+            cout << YELLOW << " | 💲 Total Toll: $" << totalToll << RESET;
+        }
+        cout << endl;
+
+        showEcoStats(vehicle, totalDistance);
+        telemetry.recordTrip(src, dest, vehicle.type, route.totalTime);
+        int trip = simulateTimeDelay(vehicle.emoji + " " + vehicle.name + ": " + src + " -> " + dest, route.totalTime);
+        subscribeRoute(trip, vehicle, route);
+    }
+
+    // ================ MULTI-CRITERIA ROUTING ================
+    // What a route costs on each criterion. CO2 is counted in whole grams so labels compare exactly.
+    struct RouteCosts {
+        int time = 0; // Seconds, as computeRoute counts them
+        int toll = 0; // Dollars, from getTollFee
+        int co2 = 0;  // Grams, from the road's base length and co2PerDistance()
+    };
+
+    struct ParetoRoute {
+        RouteCosts costs;
+        vector<int> nodes;
+        vector<int> edgeIds;
+    };
+
+    struct ParetoResult {
+        vector<ParetoRoute> routes; // Fastest first; none is at least as good as another on all three criteria
+        bool complete = true;       // False if label bounds dropped candidates, so routes may be missing
+        int labels = 0;             // Labels created, a measure of the search effort
+    };
+
+    // Every route from src to dest that no other route beats on time, toll and CO2 together, for
+    // the given vehicle under current incidents, closures and weather. A label-setting search
+    // keeps a bag of non-dominated partial routes per node. Two bounds keep it interactive:
+    // a node holds at most 'maxLabelsPerNode' labels, and the search stops after 'maxLabels'.
+    // Goal-directed pruning uses per-criterion lower bounds to the destination. It drops any
+    // label whose best possible completion is already dominated by a route found, and orders
+    // the queue by time plus the time bound. False if a node is unknown or dest is unreachable.
+    // The default caps give every trade-off on maps of a few hundred nodes, but between opposite
+    // corners of a 40x40 grid the per-node cap already binds and the result comes back
+    // incomplete; pass larger caps when the full set matters more than response time.
+    bool computeParetoRoutes(const string& src, const string& dest, const Vehicle& vehicle, ParetoResult& result,
+                             int maxLabelsPerNode = 24, int maxLabels = 500000) {
+        result = ParetoResult();
+        auto from = nodeIds.find(src), to = nodeIds.find(dest);
+        if (from == nodeIds.end() || to == nodeIds.end()) return false;
+        vector<RouteCosts> arcs;
+        vector<char> usable;
+        prepareCriteria(vehicle, arcs, usable);
+        int n = static_cast<int>(nodeNames.size()), target = to->second;
+
+        // Lower bounds to the destination, one backward search per criterion
+        vector<RouteCosts> bound(n);
+        int RouteCosts::* const criteria[] = {&RouteCosts::time, &RouteCosts::toll, &RouteCosts::co2};
+        BinaryHeapQueue& queue = pooledQueue<BinaryHeapQueue>();
+        for (int RouteCosts::* criterion : criteria) {
+            vector<int> d(n, ROUTE_UNREACHABLE);
+            queue.reset(n);
+            d[target] = 0;
+            queue.push(0, target);
+            while (!queue.empty()) {
+                pair<int, int> current = queue.pop();
+                int v = current.second;
+                if (current.first > d[v]) continue;
+                for (const Edge& edge : *nodeEdges[v]) {
+                    int arc = edge.id ^ 1; // edge.to -> v
+                    if (!usable[arc]) continue;
+                    int candidate = current.first + arcs[arc].*criterion;
+                    if (candidate < d[edge.to]) {
+                        d[edge.to] = candidate;
+                        queue.push(candidate, edge.to);
+                    }
+                }
+            }
+            if (d[from->second] == ROUTE_UNREACHABLE) return false;
+            for (int v = 0; v < n; ++v) bound[v].*criterion = d[v];
+        }
+
+        struct Label {
+            RouteCosts costs;
+            int node, parent, edgeId;
+            bool dead;
+        };
+        auto dominates = [](const RouteCosts& a, const RouteCosts& b) { return a.time <= b.time && a.toll <= b.toll && a.co2 <= b.co2; };
+        vector<Label> labels;
+        vector<vector<int>> bags(n); // Live labels per node, queued or expanded
+        vector<RouteCosts> found;    // Costs of the routes found so far
+        // Lexicographic on (time, toll, CO2) plus their lower bounds: a label leaves the queue
+        // after every label that could dominate it, so routes come out Pareto-optimal
+        priority_queue<tuple<int, int, int, int>, vector<tuple<int, int, int, int>>, greater<tuple<int, int, int, int>>> open;
+
+        auto offer = [&](const RouteCosts& costs, int node, int parent, int edgeId) {
+            if (bound[node].time == ROUTE_UNREACHABLE) return;
+            RouteCosts best = {costs.time + bound[node].time, costs.toll + bound[node].toll, costs.co2 + bound[node].co2};
+            for (const RouteCosts& route : found) if (dominates(route, best)) return; // Goal-directed pruning
+            vector<int>& bag = bags[node];
+            for (int other : bag) if (dominates(labels[other].costs, costs)) return;
+            size_t kept = 0;
+            for (int other : bag) {
+                if (dominates(costs, labels[other].costs)) labels[other].dead = true;
+                else bag[kept++] = other;
+            }
+            bag.resize(kept);
+            if (static_cast<int>(bag.size()) >= maxLabelsPerNode || static_cast<int>(labels.size()) >= maxLabels) {
+                result.complete = false;
+                return;
+            }
+            bag.push_back(static_cast<int>(labels.size()));
+            labels.push_back({costs, node, parent, edgeId, false});
+            open.emplace(best.time, best.toll, best.co2, bag.back());
+        };
+
+        offer(RouteCosts(), from->second, -1, -1);
+        while (!open.empty()) {
+            int index = get<3>(open.top());
+            open.pop();
+            if (labels[index].dead) continue;
+            Label label = labels[index]; // Copied: offer() may grow 'labels'
+            if (label.node == target) {
+                found.push_back(label.costs);
+                ParetoRoute route;
+                route.costs = label.costs;
+                for (int l = index; l >= 0; l = labels[l].parent) {
+                    route.nodes.push_back(labels[l].node);
+                    if (labels[l].edgeId >= 0) route.edgeIds.push_back(labels[l].edgeId);
+                }
+                reverse(route.nodes.begin(), route.nodes.end());
+                reverse(route.edgeIds.begin(), route.edgeIds.end());
+                result.routes.push_back(move(route));
+                continue; // Going on through the destination can only cost more
+            }
+            // Routes found since the label was queued may rule it out now
+            const RouteCosts& lower = bound[label.node];
+            RouteCosts best = {label.costs.time + lower.time, label.costs.toll + lower.toll, label.costs.co2 + lower.co2};
+            bool hopeless = false;
+            for (const RouteCosts& route : found) hopeless = hopeless || dominates(route, best);
+            if (hopeless) continue;
+            for (const Edge& edge : *nodeEdges[label.node]) {
+                if (!usable[edge.id]) continue;
+                const RouteCosts& arc = arcs[edge.id];
+                offer({label.costs.time + arc.time, label.costs.toll + arc.toll, label.costs.co2 + arc.co2}, edge.to, index, edge.id);
+            }
+        }
+        result.labels = static_cast<int>(labels.size());
+        return !result.routes.empty();
+    }
+
+    // Weighted-sum fast path for one answer: the route minimising time + secondsPerDollar * toll
+    // + secondsPerKg * CO2, by a single Dijkstra. With positive weights the answer is on the
+    // Pareto set; it trades off like a fleet policy that puts a time price on money and CO2.
+    // A zero weight can return a route that another ties on the score and beats on the ignored
+    // criterion, so the menu only accepts positive weights.
+    bool computeWeightedRoute(const string& src, const string& dest, const Vehicle& vehicle,
+                              double secondsPerDollar, double secondsPerKg, ParetoRoute& route) {
+        auto from = nodeIds.find(src), to = nodeIds.find(dest);
+        if (from == nodeIds.end() || to == nodeIds.end()) return false;
+        vector<RouteCosts> arcs;
+        vector<char> usable;
+        prepareCriteria(vehicle, arcs, usable);
+        int n = static_cast<int>(nodeNames.size());
+        vector<double> score(n, numeric_limits<double>::infinity());
+        vector<int> parentNode(n, -1), parentEdge(n, -1);
+        priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> open;
+        score[from->second] = 0;
+        open.push({0.0, from->second});
+        while (!open.empty()) {
+            pair<double, int> current = open.top();
+            open.pop();
+            int u = current.second;
+            if (u == to->second) break;
+            if (current.first > score[u]) continue;
+            for (const Edge& edge : *nodeEdges[u]) {
+                if (!usable[edge.id]) continue;
+                const RouteCosts& arc = arcs[edge.id];
+                double candidate = current.first + arc.time + secondsPerDollar * arc.toll + secondsPerKg * arc.co2 / 1000.0;
+                if (candidate < score[edge.to]) {
+                    score[edge.to] = candidate;
+                    parentNode[edge.to] = u;
+                    parentEdge[edge.to] = edge.id;
+                    open.push({candidate, edge.to});
+                }
+            }
+        }
+        if (score[to->second] == numeric_limits<double>::infinity()) return false;
+        route = ParetoRoute();
+        for (int v = to->second; v != from->second; v = parentNode[v]) {
+            int e = parentEdge[v];
+            route.edgeIds.push_back(e);
+            route.nodes.push_back(v);
+            route.costs.time += arcs[e].time;
+            route.costs.toll += arcs[e].toll;
+            route.costs.co2 += arcs[e].co2;
+        }
+        route.nodes.push_back(from->second);
+        reverse(route.nodes.begin(), route.nodes.end());
+        reverse(route.edgeIds.begin(), route.edgeIds.end());
+        return true;
+    }
+
+    // Per directed edge id: the time, toll and CO2 of driving it, and whether 'vehicle' may.
+    // Brings incidents, closures and weather up to date first, as computeRoute does.
+    void prepareCriteria(const Vehicle& vehicle, vector<RouteCosts>& arcs, vector<char>& usable) {
+        applyFeedEvents();
+        refreshIncidentClosures();
+        applyWeatherEffects();
+        RuntimeVehiclePolicy policy(vehicle);
+        double co2 = co2PerDistance(vehicle) * 1000.0; // Grams per distance unit
+        arcs.assign(edgeCount, RouteCosts());
+        usable.assign(edgeCount, 0);
+        for (int e = 0; e < edgeCount; ++e) {
+            const Edge& edge = edgeById(e);
+            usable[e] = (edge.roadBit & policy.roadMask()) != 0 && !edge.blocked && !incidentClosed[e];
+            arcs[e].time = static_cast<int>((edge.weight * (1.0 + (edge.congestion * 0.1)) + edge.signalDelay) / policy.speed());
+            arcs[e].toll = getTollFee(edge.roadType);
+            arcs[e].co2 = static_cast<int>(lround(edge.baseWeight * co2));
+        }
+    }
+
+    void showParetoRoutes(const string& src, const string& dest, const Vehicle& vehicle) {
+        if (!nodeIds.count(src) || !nodeIds.count(dest)) {
+            cout << RED << "Error: Node '" << (nodeIds.count(src) ? dest : src) << "' doesn't exist in the map!\n" << RESET;
+            return;
+        }
+        auto start_time = chrono::high_resolution_clock::now();
+        ParetoResult result;
+        bool found = computeParetoRoutes(src, dest, vehicle, result);
+        auto end_time = chrono::high_resolution_clock::now();
+        if (!found) {
+            cout << RED << "No path exists from " << src << " to " << dest << " for " << vehicle.name << "!\n" << RESET;
+            return;
+        }
+        cout << GREEN << "\nTrade-off routes for " << vehicle.emoji << " " << vehicle.name << " (" << src << " -> " << dest << "):\n" << RESET;
+        cout << BOLD << left << setw(4) << "#" << setw(10) << "Time" << setw(8) << "Toll" << setw(10) << "CO2 kg" << "Route\n" << RESET << right;
+        for (size_t i = 0; i < result.routes.size(); ++i) {
+            const ParetoRoute& route = result.routes[i];
+            cout << left << setw(4) << i + 1 << setw(10) << (to_string(route.costs.time) + "s") << setw(8) << ("$" + to_string(route.costs.toll))
+                 << setw(10) << fixed << setprecision(2) << route.costs.co2 / 1000.0 << right;
+            for (size_t k = 0; k < route.nodes.size(); ++k) cout << nodeNames[route.nodes[k]] << (k + 1 < route.nodes.size() ? " -> " : "\n");
+        }
+        if (!result.complete) cout << YELLOW << "Label limits were reached; some trade-offs may be missing.\n" << RESET;
+        cout << "Pareto search took: " << chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count()
+             << "ms (" << result.labels << " labels)\n";
+    }
+
+    void showWeightedRoute(const string& src, const string& dest, const Vehicle& vehicle, double secondsPerDollar, double secondsPerKg) {
+        if (!nodeIds.count(src) || !nodeIds.count(dest)) {
+            cout << RED << "Error: Node '" << (nodeIds.count(src) ? dest : src) << "' doesn't exist in the map!\n" << RESET;
+            return;
+        }
+        ParetoRoute route;
+        if (!computeWeightedRoute(src, dest, vehicle, secondsPerDollar, secondsPerKg, route)) {
+            cout << RED << "No path exists from " << src << " to " << dest << " for " << vehicle.name << "!\n" << RESET;
+            return;
+        }
+        cout << GREEN << "\nWeighted route for " << vehicle.emoji << " " << vehicle.name << ":\n" << RESET;
+        for (size_t i = 0; i < route.nodes.size(); ++i) cout << BOLD << nodeNames[route.nodes[i]] << RESET << (i + 1 < route.nodes.size() ? " -> " : "\n");
+        cout << "⏱️ Total time: " << route.costs.time << "s" << YELLOW << " | 💲 Total Toll: $" << route.costs.toll << RESET
+             << GREEN << " | CO2: " << fixed << setprecision(2) << route.costs.co2 / 1000.0 << " kg\n" << RESET;
+    }
+
+    // ================ DATA EXPORT ================
+    // One-shot snapshot of every road, formatted into a single buffer and written in one call.
+    void exportToCSV() {
+        FILE* out = fopen("traffic_data.csv", "wb");
+        if (!out) {
+            cout << RED << "Error: Could not open traffic_data.csv for writing. Check permissions.\n" << RESET;
+            return;
+        }
+        string buffer = "Source,Destination,RoadType,OriginalWeight,CurrentWeight,SignalDelay,Blocked,Congestion,Flow\n";
+        buffer.reserve(buffer.size() + edgeCount * 96);
+        for (auto& node : adjList) {
+            for (auto& edge : node.second) {
+                buffer += node.first; buffer += ',';
+                buffer += edge.destination; buffer += ',';
+                buffer += edge.roadType; buffer += ',';
+                appendNumber(buffer, edge.baseWeight); buffer += ',';
+                appendNumber(buffer, edge.weight); buffer += ',';
+                buffer += to_string(edge.signalDelay); buffer += ',';
+                buffer += edge.blocked ? "TRUE," : "FALSE,";
+                buffer += to_string(edge.congestion); buffer += ',';
+                appendNumber(buffer, edge.flow); buffer += '\n';
+            }
+        }
+        fwrite(buffer.data(), 1, buffer.size(), out);
+        fclose(out);
+        cout << GREEN << "📊 Data exported to traffic_data.csv\n" << RESET;
+    }
+
+    // Captures the current state of every road (plus any new roads' static rows) into the
+    // streaming exporter. Runs on the simulation thread; encoding and I/O happen on the writer.
+    void streamTelemetry(uint32_t tick) {
+        if (!telemetry.active()) return;
+        TelemetryFrame& frame = telemetry.frame();
+        int firstNew = telemetry.staticEdgesSent();
+        int added = edgeCount - firstNew;
+        frame.staticId.resize(added); frame.staticSource.resize(added); frame.staticDestination.resize(added);
+        frame.staticRoadType.resize(added); frame.staticBaseWeight.resize(added); frame.staticSignalDelay.resize(added);
+        frame.weight.resize(edgeCount); frame.flow.resize(edgeCount);
+        frame.congestion.resize(edgeCount); frame.blocked.resize(edgeCount);
+
+        for (size_t u = 0; u < nodeEdges.size(); ++u) {
+            for (const Edge& edge : *nodeEdges[u]) {
+                frame.weight[edge.id] = static_cast<float>(edge.weight);
+                frame.flow[edge.id] = static_cast<float>(edge.flow);
+                frame.congestion[edge.id] = static_cast<uint8_t>(edge.congestion);
+                frame.blocked[edge.id] = edge.blocked;
+                if (edge.id >= firstNew) {
+                    int row = edge.id - firstNew;
+                    frame.staticId[row] = edge.id;
+                    frame.staticSource[row] = telemetry.code(nodeNames[u]);
+                    frame.staticDestination[row] = telemetry.code(edge.destination);
+                    frame.staticRoadType[row] = telemetry.code(edge.roadType);
+                    frame.staticBaseWeight[row] = static_cast<float>(edge.baseWeight);
+                    frame.staticSignalDelay[row] = edge.signalDelay;
+                }
+            }
+        }
+        telemetry.submit(tick, edgeCount);
+    }
+
+    // ================ EXTERNAL FEED APPLICATION ================
+    // Drains queued feed events and applies them as one batch.
+    void applyFeedEvents() {
+        feedBatch.clear();
+        if (feed.drain(feedBatch, FEED_BATCH_LIMIT) == 0) return;
+        applyFeedBatch(feedBatch);
+    }
+
+    // Applies feed events together: incidents go to the incident index in one step,
+    // closures/reopenings flip both directions of a road, weather is set directly.
+    void applyFeedBatch(const vector<FeedEvent>& batch) {
+        vector<IncidentMonitor::Incident> incidents;
+        for (const FeedEvent& event : batch) {
+            switch (event.kind) {
+                case FEED_INCIDENT: {
+                    IncidentMonitor::Incident incident;
+                    incident.location = event.location;
+                    incident.type = event.label;
+                    incident.severity = event.severity;
+                    incident.timestamp = time(nullptr); // Ages out like any other incident
+                    incident.roadType = event.roadType;
+                    incidents.push_back(incident);
+                    telemetry.recordIncident(incident.location, incident.type, incident.severity, incident.roadType);
+                    break;
+                }
+                case FEED_CLOSURE:
+                case FEED_REOPEN:
+                    setRoadBlocked(event.location, event.target, event.kind == FEED_CLOSURE);
+                    break;
+                case FEED_WEATHER:
+                    currentWeather = event.weather;
+                    break;
+            }
+        }
+        IncidentMonitor::getInstance().addIncidents(incidents);
+    }
+
+    // ================ LIVE RE-ROUTING ================
+    // Keeps a trip re-routable for as long as it is being played back. The route must come
+    // from computeRoute() for the same vehicle, so incident closures and weather are current.
+    void subscribeRoute(int trip, const Vehicle& vehicle, const Route& route) {
+        if (route.nodes.size() < 2) return;
+        if (subscriptions.empty()) snapshotWatchedCosts(); // Start diffing from the current state
+        auto inserted = subscriptions.emplace(trip, RouteSubscription(trip, route.nodes.back(), vehicle));
+        RouteSubscription& sub = inserted.first->second;
+        sub.label = nodeNames[route.nodes.front()] + " -> " + nodeNames[route.nodes.back()];
+        growTree(sub);
+        sub.planNodes = route.nodes;
+        sub.planArrival.assign(1, 0);
+        for (int edge : route.edgeIds) sub.planArrival.push_back(sub.planArrival.back() + sub.cost[edge]);
+    }
+
+    // Finds roads whose cost changed since the last call, repairs every subscribed tree that the
+    // changes touch and re-plans affected trips from the next node they reach. Trips whose trees
+    // and routes are unaffected cost a few comparisons per changed road.
+    void refreshSubscriptions() {
+        if (subscriptions.empty()) return;
+        if (watchedWeather != currentWeather) { // A weather change rescales every road
+            applyWeatherEffects();
+            watchedWeather = currentWeather;
+        }
+        refreshIncidentClosures();
+
+        vector<int> changed;
+        watchedCost.resize(edgeCount, -2); // Roads added since the last refresh count as changed
+        for (int e = 0; e < edgeCount; ++e) {
+            double now = watchedBaseCost(edgeById(e));
+            if (now != watchedCost[e]) { watchedCost[e] = now; changed.push_back(e); }
+        }
+        if (changed.empty()) return;
+
+        auto start = chrono::high_resolution_clock::now();
+        for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+            double elapsed;
+            if (!trips.elapsedOf(it->first, elapsed)) { it = subscriptions.erase(it); continue; } // Arrived or cancelled
+            RouteSubscription& sub = it->second;
+            bool regrow = changed.size() * 4 > static_cast<size_t>(edgeCount) || sub.cost.size() != static_cast<size_t>(edgeCount);
+            bool treeChanged = regrow ? (growTree(sub), true) : repairTree(sub, changed);
+            if (treeChanged) {
+                ++treeRepairs;
+                replan(sub, elapsed, start);
+            }
+            ++it;
+        }
+    }
+
+    // Printed by the menu thread between prompts; the watcher only queues them.
+    void showRerouteNotices() {
+        for (const string& line : rerouteNotices) cout << line;
+        rerouteNotices.clear();
+    }
+
+    void showReroutingStatus() const {
+        cout << "Live re-routing: " << subscriptions.size() << " trip(s) subscribed | tree repairs: " << treeRepairs
+             << " | re-routes: " << reroutes << "\n";
+    }
+
+    // ================ SHARDING ================
+    // Splits the nodes into 'parts' shards of near-equal size with few roads between them, and
+    // returns the shard of each node id. Recursive bisection: each half is grown breadth-first from
+    // a peripheral node, so shards are compact regions; a refinement pass then moves nodes to the
+    // shard most of their roads lead to while shard sizes stay within 5% of the target.
+    vector<int> partitionNodes(int parts) {
+        const int n = static_cast<int>(nodeNames.size());
+        parts = max(1, min(parts, n));
+        vector<int> part(n, 0), nodes(n), member(n, 0), seen(n, 0);
+        for (int v = 0; v < n; ++v) nodes[v] = v;
+        int stamp = 0;
+        if (n > 0) bisectNodes(nodes, 0, parts, part, member, seen, stamp);
+
+        vector<int> size(parts, 0), links(parts, 0);
+        for (int v = 0; v < n; ++v) ++size[part[v]];
+        const int target = n / parts, slack = max(1, target / 20);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int u = 0; u < n; ++u) {
+                for (const Edge& edge : *nodeEdges[u]) ++links[part[edge.to]];
+                int home = part[u], best = home;
+                for (const Edge& edge : *nodeEdges[u]) if (links[part[edge.to]] > links[best]) best = part[edge.to];
+                if (best != home && size[best] < target + slack && size[home] > max(1, target - slack)) {
+                    part[u] = best;
+                    --size[home];
+                    ++size[best];
+                }
+                for (const Edge& edge : *nodeEdges[u]) links[part[edge.to]] = 0;
+                links[home] = 0;
+            }
+        }
+        return part;
+    }
+
+    // Builds this (empty) graph as shard 'shard' of 'master': the shard's nodes and the roads
+    // between them, with their current weights, blocked state and congestion.
+    void loadShard(const Graph& master, const vector<int>& part, int shard) {
+        for (size_t v = 0; v < master.nodeNames.size(); ++v) if (part[v] == shard) internNode(master.nodeNames[v]);
+        for (int e = 0; e < master.edgeCount; e += 2) { // Even ids are the roads as added, odd ids their reverse
+            int u = master.edgeSlots[e].first;
+            const Edge& forward = (*master.nodeEdges[u])[master.edgeSlots[e].second];
+            const pair<int, int>& back = master.edgeSlots[e ^ 1];
+            const Edge& backward = (*master.nodeEdges[back.first])[back.second];
+            if (part[u] != shard || part[forward.to] != shard) continue;
+            addRoad(master.nodeNames[u], forward.destination, 0, forward.signalDelay, forward.roadType, false);
+            for (int k = 0; k < 2; ++k) {
+                const Edge& source = k ? backward : forward;
+                Edge& copy = edgeById(edgeCount - 2 + k);
+                copy.baseWeight = source.baseWeight;
+                copy.weight = source.weight;
+                copy.blocked = source.blocked;
+                copy.congestion = source.congestion;
+            }
+        }
+        appliedWeather = master.appliedWeather;
+    }
+
+    // One request of the shard worker protocol (see ShardCoordinator) against this shard's roads.
+    // 'boundary' holds the ids of the shard's nodes that have roads to other shards.
+    string answerShardRequest(const string& request, const vector<int>& boundary) {
+        vector<string> fields = splitFields(request, '|');
+        const string& op = fields[0];
+        if (op == "TICK" && fields.size() == 2) {
+            vector<int> roads(edgeCount);
+            for (int e = 0; e < edgeCount; ++e) roads[e] = e;
+            int changed = driftCongestion(roads, static_cast<uint32_t>(strtoul(fields[1].c_str(), nullptr, 10)));
+            recordTrafficSnapshot();
+            return "OK|" + to_string(changed);
+        }
+        if (op == "WEATHER" && fields.size() == 2) {
+            currentWeather = static_cast<WeatherType>(min(max(atoi(fields[1].c_str()), 0), static_cast<int>(STORM)));
+            return "OK";
+        }
+
+        VehicleType type;
+        bool emergency;
+        if (fields.size() < 2 || !parseVehicleName(fields[1], type, emergency)) return "ERR|malformed " + op;
+        Vehicle vehicle(type, emergency);
+        refreshIncidentClosures();
+        applyWeatherEffects();
+        QueryWorkspace& ws = queryWorkspace();
+        auto appendDistance = [](string& text, int d) { text += to_string(d == ROUTE_UNREACHABLE ? -1 : d); };
+
+        string text = "OK|";
+        if (op == "BOUNDARY" && fields.size() == 2) {
+            for (size_t i = 0; i < boundary.size(); ++i) {
+                searchRoute(boundary[i], -1, vehicle, ws);
+                if (i) text += ';';
+                for (size_t j = 0; j < boundary.size(); ++j) {
+                    if (j) text += ',';
+                    appendDistance(text, ws.distance(boundary[j]));
+                }
+            }
+            return text;
+        }
+        auto node = [&](const string& name) { auto it = nodeIds.find(name); return it == nodeIds.end() ? -1 : it->second; };
+        if ((op == "FROM" || op == "TO") && fields.size() == 3) {
+            int v = node(fields[2]);
+            if (v < 0) return "ERR|unknown node " + fields[2];
+            RouteSubscription tree(-1, v, vehicle);
+            if (op == "FROM") searchRoute(v, -1, vehicle, ws);
+            else growTree(tree); // Reverse tree: time from every node to v
+            for (size_t i = 0; i < boundary.size(); ++i) {
+                if (i) text += ',';
+                appendDistance(text, op == "FROM" ? ws.distance(boundary[i]) : tree.dist[boundary[i]]);
+            }
+            return text;
+        }
+        if (op == "PATH" && fields.size() == 4) {
+            int from = node(fields[2]), to = node(fields[3]);
+            if (from < 0 || to < 0) return "ERR|unknown node " + fields[from < 0 ? 2 : 3];
+            int time = searchRoute(from, to, vehicle, ws);
+            if (time < 0) return "ERR|unreachable";
+            text += to_string(time);
+            for (int v : ws.pathNodes) text += "|" + nodeNames[v];
+            return text;
+        }
+        return "ERR|malformed " + op;
+    }
+
+    // Blocks or reopens both directions of the road between u and v; false if there is no such road.
+    bool setRoadBlocked(const string& u, const string& v, bool blocked) {
+        auto from = nodeIds.find(u), to = nodeIds.find(v);
+        if (from == nodeIds.end() || to == nodeIds.end()) return false;
+        bool found = false;
+        for (Edge& edge : *nodeEdges[from->second]) if (edge.to == to->second) { edge.blocked = blocked; found = true; }
+        for (Edge& edge : *nodeEdges[to->second]) if (edge.to == from->second) { edge.blocked = blocked; found = true; }
+        return found;
+    }
+
+    // Raises a random incident and, if one occurred, streams it.
+    void reportIncident() {
+        IncidentMonitor& monitor = IncidentMonitor::getInstance();
+        if (monitor.generateIncident()) {
+            const IncidentMonitor::Incident& incident = monitor.latestIncident();
+            telemetry.recordIncident(incident.location, incident.type, incident.severity, incident.roadType);
+        }
+    }
+
+    // ================ TRAFFIC HISTORY & PREDICTION ================
+    // Records one observation (current travel time and congestion) for every road segment.
+    void recordTrafficSnapshot() {
+        time_t now = time(nullptr);
+        int hour = localtime(&now)->tm_hour;
+        for (auto& nodePair : adjList) {
+            for (auto& edge : nodePair.second) {
+                double travelTime = edge.weight * (1.0 + edge.congestion * 0.1) + edge.signalDelay;
+                edgeHistory[edge.id].record(now, hour, travelTime, edge.congestion);
+            }
+        }
+    }
+
+    // Forecasts congestion over the next hour along the current car route between two nodes.
+    void predictRouteCongestion(const string& src, const string& dest) {
+        vector<const EdgeHistory*> histories;
+        Route route;
+        if (computeRoute(src, dest, Vehicle(CAR), route)) {
+            for (int id : route.edgeIds) histories.push_back(&edgeHistory[id]);
+        }
+        ai.predictCongestion(src, dest, histories);
+    }
+
+    // ================ TRAFFIC ASSIGNMENT (USER EQUILIBRIUM) ================
+    struct AssignmentResult {
+        int iterations = 0;
+        double relativeGap = 1.0;
+        double totalTravelTime = 0;  // Vehicle-seconds per hour at equilibrium
+        double unassignedTrips = 0;  // Demand with no usable path for the vehicle
+    };
+
+    // Frank-Wolfe: load all demand onto current shortest paths (all-or-nothing), then shift
+    // the flows towards that loading by the step that minimises the Beckmann objective.
+    // Equilibrium flows are written back to every edge's flow and weight. The congested time
+    // already includes the delay from the volume, so congestion is cleared rather than applied
+    // on top; the weights hold until the weather next changes.
+    AssignmentResult assignTraffic(const DemandMatrix& demand, const Vehicle& vehicle,
+                                   int maxIterations = ASSIGNMENT_MAX_ITERATIONS,
+                                   double gapTolerance = ASSIGNMENT_GAP_TOLERANCE) {
+        AssignmentResult result;
+        applyWeatherEffects();
+        refreshIncidentClosures();
+
+        // Flatten the network once: free-flow time, capacity and usability per edge id. Free flow
+        // comes from the base weight, as the live weight may hold a previous assignment's delay.
+        double weatherMult = getWeatherMultiplier();
+        vector<double> freeFlow(edgeCount, 0.0), capacity(edgeCount, 1.0);
+        vector<char> usable(edgeCount, 0);
+        for (size_t u = 0; u < nodeEdges.size(); ++u) {
+            for (const Edge& edge : *nodeEdges[u]) {
+                freeFlow[edge.id] = edge.baseWeight / weatherMult + edge.signalDelay;
+                capacity[edge.id] = getRoadCapacity(edge.roadType);
+                usable[edge.id] = !edge.blocked && !incidentClosed[edge.id] && vehicle.canUseRoad(edge.roadType);
+            }
+        }
+
+        // Group demand by origin so each shortest-path tree is grown once per origin
+        map<int, vector<pair<int, double>>> byOrigin;
+        for (const auto& od : demand.trips) {
+            auto o = nodeIds.find(od.first.first), d = nodeIds.find(od.first.second);
+            if (o == nodeIds.end() || d == nodeIds.end()) { result.unassignedTrips += od.second; continue; }
+            byOrigin[o->second].push_back({d->second, od.second});
+        }
+        vector<OriginDemand> origins(byOrigin.begin(), byOrigin.end());
+
+        vector<double> flow, target, times(freeFlow);
+        result.unassignedTrips += allOrNothing(origins, times, usable, flow);
+
+        for (int iter = 1; iter <= maxIterations; ++iter) {
+            for (int e = 0; e < edgeCount; ++e) times[e] = volumeDelay(freeFlow[e], flow[e], capacity[e]);
+            allOrNothing(origins, times, usable, target);
+
+            double currentCost = 0, shortestCost = 0;
+            for (int e = 0; e < edgeCount; ++e) {
+                currentCost += times[e] * flow[e];
+                shortestCost += times[e] * target[e];
+            }
+            result.iterations = iter;
+            result.relativeGap = (currentCost > 0) ? (currentCost - shortestCost) / currentCost : 0.0;
+            if (result.relativeGap < gapTolerance) break;
+
+            // Bisection on the directional derivative of the Beckmann objective
+            double lo = 0.0, hi = 1.0;
+            for (int i = 0; i < 30; ++i) {
+                double mid = (lo + hi) / 2, slope = 0;
+                for (int e = 0; e < edgeCount; ++e) {
+                    double delta = target[e] - flow[e];
+                    if (delta != 0) slope += volumeDelay(freeFlow[e], flow[e] + mid * delta, capacity[e]) * delta;
+                }
+                if (slope > 0) hi = mid; else lo = mid;
+            }
+            double step = (lo + hi) / 2;
+            for (int e = 0; e < edgeCount; ++e) flow[e] += step * (target[e] - flow[e]);
+        }
+
+        // Write the equilibrium state back onto the live edges
+        for (auto& nodePair : adjList) {
+            for (auto& edge : nodePair.second) {
+                double cap = capacity[edge.id];
+                double congestedTime = volumeDelay(freeFlow[edge.id], flow[edge.id], cap);
+                edge.flow = flow[edge.id];
+                edge.weight = max(0.0, congestedTime - edge.signalDelay);
+                edge.congestion = 0; // Counted in the weight
+                result.totalTravelTime += congestedTime * edge.flow;
+            }
+        }
+        return result;
+    }
+
+    void showAssignmentReport(const AssignmentResult& result) {
+        cout << CYAN << "\n=== TRAFFIC ASSIGNMENT (USER EQUILIBRIUM) ===\n" << RESET;
+        cout << "Iterations: " << result.iterations
+             << " | Relative gap: " << scientific << setprecision(2) << result.relativeGap << fixed << "\n";
+        cout << "Total travel time: " << setprecision(1) << result.totalTravelTime / 3600.0 << " vehicle-hours/hour\n";
+        if (result.unassignedTrips > 0) {
+            cout << YELLOW << "Unassigned trips (no usable path): " << setprecision(0) << result.unassignedTrips << "\n" << RESET;
+        }
+
+        // Five busiest road segments by volume/capacity ratio
+        vector<pair<double, string>> loads;
+        for (auto& nodePair : adjList) {
+            for (auto& edge : nodePair.second) {
+                if (edge.flow <= 0) continue;
+                stringstream label;
+                label << nodePair.first << " -> " << edge.destination << " (" << fixed << setprecision(0)
+                      << edge.flow << " veh/h, " << edge.weight + edge.signalDelay << "s)";
+                loads.push_back({edge.flow / getRoadCapacity(edge.roadType), label.str()});
+            }
+        }
+        sort(loads.rbegin(), loads.rend());
+        cout << BOLD << "Busiest roads (volume/capacity):\n" << RESET;
+        for (size_t i = 0; i < loads.size() && i < 5; ++i) {
+            string color = loads[i].first > 1.0 ? RED : (loads[i].first > 0.7 ? YELLOW : GREEN);
+            cout << "  " << color << fixed << setprecision(2) << loads[i].first << RESET << "  " << loads[i].second << "\n";
+        }
+    }
+
+    // ================ MONTE CARLO SCENARIOS ================
+    // Travel-time distributions for every OD pair of 'demand' (the sample demand when empty) over
+    // 'runs' random scenarios of the current network; see MonteCarloRunner.
+    vector<MonteCarloRunner::Distribution> runScenarios(const DemandMatrix& demand, const Vehicle& vehicle, int runs,
+                                                        uint64_t seed, unsigned threads) {
+        vector<RoutingSnapshot::ArcTerms> terms;
+        shared_ptr<RoutingSnapshot> base = makeSnapshot(&terms);
+        MonteCarloRunner runner(base, move(terms));
+        vector<pair<string, string>> pairs;
+        for (const auto& od : (demand.trips.empty() ? sampleDemand() : demand).trips) pairs.push_back(od.first);
+        return runner.run(pairs, vehicle, runs, seed, threads);
+    }
+
+    // ================ BATCH SHORTEST PATHS ================
+    // Travel times from every source to every node, for coverage and matrix work: the time from
+    // sources[i] to node id v is dist[i * nodeCount + v], ROUTE_UNREACHABLE when there is no
+    // route. Sources are swept LANES at a time through a contraction hierarchy (see
+    // ContractionHierarchy::sweepBatch), which is rebuilt only when the roads, weather, incidents
+    // or vehicle changed since the last call. False if a source is not a node.
+    bool batchShortestPaths(const vector<string>& sources, const Vehicle& vehicle, vector<int>& dist,
+                            ContractionHierarchy::BatchKernel kernel = ContractionHierarchy::BATCH_AUTO) {
+        vector<int> ids;
+        for (const string& name : sources) {
+            auto it = nodeIds.find(name);
+            if (it == nodeIds.end()) return false;
+            ids.push_back(it->second);
+        }
+        shared_ptr<RoutingSnapshot> net = makeSnapshot();
+        uint64_t key = SplitMix64(vehicle.roadMask ^ static_cast<uint64_t>(vehicle.speedMultiplier * 1e6)).next();
+        for (int u = 0; u < static_cast<int>(net->nodes->names.size()); ++u) {
+            key = SplitMix64(key ^ static_cast<uint64_t>(net->firstArc[u + 1])).next();
+            for (int a = net->firstArc[u]; a < net->firstArc[u + 1]; ++a) {
+                const RoutingSnapshot::Arc& arc = net->arcs[a];
+                uint64_t costBits;
+                memcpy(&costBits, &arc.cost, sizeof(costBits));
+                key = SplitMix64(key ^ (static_cast<uint64_t>(arc.to) << 32) ^ arc.roadBit ^ costBits).next();
+            }
+        }
+        if (!batchHierarchy || key != batchKey) {
+            batchHierarchy.reset(new ContractionHierarchy(*net, vehicle));
+            batchKey = key;
+        }
+        batchHierarchy->sweepBatch(ids, dist, kernel);
+        return true;
+    }
+
+    // ================ TUTORIAL MODE ================
+    void runTutorial() {
+        cout << CYAN << "\n=== INTERACTIVE TUTORIAL ===\n" << RESET;
+        vector<string> steps = {
+            "Welcome to the Traffic Simulation! Let's get started.",
+            "1. First, we need to add roads. Choose option " + BOLD + "1" + RESET + " from the main menu.",
+            "   You'll enter a start node, end node, weight (time in seconds), signal delay, and road type.",
+            "   Try adding: Downtown -> Midtown (300s, 60s, Highway)",
+            "   Then: Midtown -> Market St (120s, 30s, General)",
+            "2. Now, let's view the map. Choose option " + BOLD + "12" + RESET + " (Enhanced Live Map).",
+            "   You should see the roads you added and default ones.",
+            "3. Time to simulate! Choose option " + BOLD + "5" + RESET + " (Calculate Shortest Path).",
+            "   Enter 'Downtown' as source and 'Market St' as destination. Pick 'Car' (option 1).",
+            "   See the route and total time. The journey then plays back in the background (option 19).",
+            "4. Observe dynamic changes: The simulation automatically updates weather and generates incidents.",
+            "   You can manually generate an incident with option " + BOLD + "3" + RESET + " (Simulate/View Incidents).",
+            "5. Compare vehicle types! Choose option " + BOLD + "6" + RESET + " (Compare Vehicle Routes).",
+            "   Input the same start/end nodes. Notice how an 'Ambulance' takes a shorter time due to emergency speed.",
+            "6. Leverage AI! Choose option " + BOLD + "9" + RESET + " (AI Traffic Analysis).",
+            "   Enter start/end nodes to get route recommendations and congestion predictions.",
+            "7. Explore other features: 'Time Controls' (" + BOLD + "13" + RESET + "), 'City Stats' (" + BOLD + "11" + RESET + "), and 'Export Data' (" + BOLD + "14" + RESET + ").",
+            "That's it for the basic tutorial! Enjoy exploring the traffic simulation."
+        };
+
+        for (const string& step : steps) {
+            cout << step << endl;
+            sleep_seconds(5); // Give user time to read each step
+        }
+        cout << GREEN << "\nTutorial finished! Returning to Main Menu.\n" << RESET;
+    }
+
+    // ================ STRATEGY PATTERN FOR ROUTING ================
+    class RoutingStrategy {
+    public:
+        virtual ~RoutingStrategy() {}
+        virtual void calculate(Graph& g, const string& src,
+                             const string& dest) = 0;
+    };
+
+    // Strategy bound to a stock vehicle policy; its routes always run the specialised kernel.
+    template <class Policy>
+    class PolicyRoute : public RoutingStrategy {
+    public:
+        void calculate(Graph& g, const string& src,
+                     const string& dest) override {
+            g.shortestPath(src, dest, Policy::vehicle());
+        }
+    };
+
+    typedef PolicyRoute<VehiclePolicy<CAR, false>> FastestRoute;          // Default to car for fastest
+    typedef PolicyRoute<VehiclePolicy<AMBULANCE, true>> EmergencyRoute;   // Ambulance in emergency mode
+
+
+    // ================ MAIN MENU WITH ALL FEATURES ================
+    void mainMenu() {
+        addDefaultRoads(); // Initialize with some predefined roads
+        string src, dest;
+        int tick = 0; // Simulation "tick" counter for periodic events
+
+        // Re-routes trips in flight as soon as the weather thread or an incident changes the
+        // roads, including while the menu is waiting for input.
+        atomic<bool> menuRunning{true};
+        thread rerouteWatcher([&] {
+            while (menuRunning) {
+                this_thread::sleep_for(chrono::milliseconds(20));
+                lock_guard<mutex> lock(simulationMutex);
+                if (!subscriptions.empty() && (watchedWeather != currentWeather || closuresVersion != IncidentMonitor::getInstance().version())) {
+                    refreshSubscriptions();
+                }
+            }
+        });
+        unique_lock<mutex> simulationLock(simulationMutex);
+
+        while (true) {
+            // Periodic updates for dynamic simulation aspects
+            tick++;
+            // Weather updates are now handled by a separate thread
+            if (tick % 10 == 0) reportIncident(); // Generate incidents every 10 ticks
+            if (tick % 30 == 0) ai.optimizeTrafficLights(); // AI optimization every 30 ticks
+            recordTrafficSnapshot(); // Feed every road's history with its current state
+            applyFeedEvents();       // Apply incidents/closures/weather from the external feed
+            refreshSubscriptions();  // Re-route trips in flight around whatever changed
+            streamTelemetry(tick);   // Append this tick to the telemetry stream, if running
+
+            // Clear console for fresh menu display - improves readability
+#ifdef _WIN32
+            system("cls"); // For Windows
+#else
+            system("clear"); // For Linux/macOS
+#endif
+
+            // --- ASCII Art Title (colored) ---
+            cout << BLUE << R"(
+  _____  _____  ___  ______ _____ _   _ _____
+ |_   |/  __ \/ _ \ | ___ \_   _| \ | |  __ \
+   | |  | /  \/ /_\ \| |_/ / | | |  \| | |  \/
+   | |  | |   |  _  ||  _ /  | | | . ` | | __
+  _| |_ | \__/\ | | || |\ \| _| |_| |\  | |_\ \
+  \___/  \____|_| |_|_| \_|\___/\_| \_/\____/
+            )" << RESET << endl;
+
+            cout << CYAN << "\n=== MAIN MENU ===" << RESET << endl;
+            // Applying colors to menu options
+            cout << GREEN << "1. " << WHITE << "Add Road\n";
+            cout << GREEN << "2. " << WHITE << "View Map (Basic)\n"; // Keeping for compatibility, but 12 is enhanced
+            cout << GREEN << "3. " << WHITE << "Simulate/View Incidents\n";
+            cout << GREEN << "4. " << WHITE << "Apply Rush Hour Conditions\n";
+            cout << GREEN << "5. " << WHITE << "Calculate Shortest Path\n";
+            cout << GREEN << "6. " << WHITE << "Compare Vehicle Routes (Car vs. Ambulance)\n";
+            cout << GREEN << "7. " << WHITE << "Waypoint Routing (Limited)\n";
+            cout << YELLOW << "8. " << WHITE << "Save/Load Data (Not Implemented)\n"; // Indicate non-implemented
+            cout << AI_COLOR << "9. " << WHITE << "AI Traffic Analysis\n";
+            cout << EMERGENCY_COLOR << "10. " << WHITE << "Emergency Mode (Simulate Siren)\n";
+            cout << MAGENTA << "11. " << WHITE << "City Traffic Statistics\n";
+            cout << CYAN << "12. " << WHITE << "Enhanced Live Map\n";
+            cout << YELLOW << "13. " << WHITE << "Time Controls\n";
+            cout << GREEN << "14. " << WHITE << "Export Traffic Data to CSV\n";
+            cout << BLUE << "15. " << WHITE << "Run Interactive Tutorial\n";
+            cout << MAGENTA << "16. " << WHITE << "Traffic Assignment (OD Demand)\n";
+            cout << GREEN << "17. " << WHITE << "Streaming Telemetry Export (Start/Stop)\n";
+            cout << EMERGENCY_COLOR << "18. " << WHITE << "Incident Feed Ingestion (Start/Stop)\n";
+            cout << YELLOW << "19. " << WHITE << "Trips in Progress (Watch/Cancel)\n";
+            cout << AI_COLOR << "20. " << WHITE << "Monte Carlo What-If Runs (Travel Time Percentiles)\n";
+            cout << EMERGENCY_COLOR << "21. " << WHITE << "Isochrones & Station Coverage\n";
+            cout << MAGENTA << "22. " << WHITE << "Trade-off Routes (Time / Toll / CO2)\n";
+            cout << RED << "0. " << WHITE << "Exit Simulation\n";
+            cout << BOLD << "Select option: " << RESET;
+
+            string inputLine;
+            simulationLock.unlock(); // Let the re-routing watcher work while the menu waits
+            getline(cin, inputLine); // Read the whole line of user input, robust against mixed input
+            simulationLock.lock();
+
+            int ch;
+            stringstream ss(inputLine);
+            if (!(ss >> ch)) { // Attempt to convert string to int
+                ch = -1; // If conversion fails (e.g., user types text), assign an invalid option
+            }
+
+            if (ch == 0) {
+                cout << GREEN << "Exiting Traffic Simulation. Goodbye!\n" << RESET;
+                break; // Exit the loop
+            }
+
+            // Using a switch statement for menu navigation
+            switch (ch) {
+                case 1: { // Add Road
+                    string u, v, type;
+                    string w_str, sd_str;
+                    int w_val, sd_val;
+
+                    cout << "Enter start node: ";
+                    getline(cin, u);
+                    // Input Validation: Start node cannot be empty
+                    if (u.empty()) {
+                        cout << RED << "Error: Start node name cannot be empty!\n" << RESET;
+                        break;
+                    }
+
+                    cout << "Enter end node: ";
+                    getline(cin, v);
+                    // Input Validation: End node cannot be empty
+                    if (v.empty()) {
+                        cout << RED << "Error: End node name cannot be empty!\n" << RESET;
+                        break;
+                    }
+                    if (u == v) {
+                        cout << RED << "Error: Start and end nodes cannot be the same for a road!\n" << RESET;
+                        break;
+                    }
+
+                    try {
+                        cout << "Enter weight (time in seconds, e.g., 300): ";
+                        getline(cin, w_str);
+                        w_val = stoi(w_str);
+                        if (w_val <= 0) {
+                            cout << RED << "Error: Weight must be a positive integer.\n" << RESET;
+                            break;
+                        }
+
+                        cout << "Enter signal delay (seconds, e.g., 60): ";
+                        getline(cin, sd_str);
+                        sd_val = stoi(sd_str);
+                        if (sd_val < 0) {
+                            cout << RED << "Error: Signal delay cannot be negative.\n" << RESET;
+                            break;
+                        }
+                    } catch (const invalid_argument& e) {
+                        cout << RED << "Invalid number input. Please enter integers for weight and delay.\n" << RESET;
+                        break; // Go back to main menu
+                    } catch (const out_of_range& e) {
+                        cout << RED << "Input number out of range. Please enter smaller integers.\n" << RESET;
+                        break; // Go back to main menu
+                    }
+
+                    cout << "Enter road type (General, Bike Lane, Bus Lane, Highway, Bridge, Tunnel): ";
+                    getline(cin, type);
+                    // Basic validation for road type
                     if (type.empty()) {
                         cout << YELLOW << "Warning: Road type not specified. Defaulting to 'General'.\n" << RESET;
                         type = "General";
                     }
 
-                    addRoad(u, v, w_val, sd_val, type);
-                    break;
+                    addRoad(u, v, w_val, sd_val, type);
+                    break;
+                }
+                case 2: // View Map (Basic) - now points to Enhanced Map
+                case 12: { // Enhanced Live Map
+                    showEnhancedMap();
+                    break;
+                }
+                case 3: { // Simulate/View Incidents
+                    reportIncident(); // Generate a new incident
+                    IncidentMonitor::getInstance().showActiveIncidents(); // Show all active incidents (Singleton access)
+                    break;
+                }
+                case 4: { // Apply Rush Hour Conditions
+                    cout << YELLOW << "\nApplying rush hour conditions...\n" << RESET;
+                    for (auto& nodePair : adjList) {
+                        for (auto& edge : nodePair.second) {
+                            // Retrieve the original base weight from baseEdges
+                            double originalWeight = 0;
+                            // Memory Safety: Check if key exists before using .at()
+                            if (baseEdges.count({nodePair.first, edge.destination})) {
+                                originalWeight = baseEdges.at({nodePair.first, edge.destination}).weight;
+                            } else if (baseEdges.count({edge.destination, nodePair.first})) {
+                                originalWeight = baseEdges.at({edge.destination, nodePair.first}).weight;
+                            }
+                            if (originalWeight == 0) originalWeight = edge.weight; // Fallback
+
+                            edge.weight = originalWeight * 1.5; // Increase travel time by 50%
+                            edge.congestion = simulationRng().below(MAX_CONGESTION) + 1; // Add 1-MAX_CONGESTION congestion units
+                        }
+                    }
+                    appliedWeather = -1; // Weights no longer reflect weather alone
+                    cout << GREEN << "Rush hour applied! Traffic is heavier and slower.\n" << RESET;
+                    break;
+                }
+                case 5: { // Calculate Shortest Path (with Strategy Pattern selection)
+                    cout << "Enter source node: "; getline(cin, src);
+                    cout << "Enter destination node: "; getline(cin, dest);
+
+                    cout << "Select routing strategy (1: " << YELLOW << "Fastest Route" << RESET << ", 2: " << RED << "Emergency Route" << RESET << "): ";
+                    string strategyChoiceStr;
+                    getline(cin, strategyChoiceStr);
+                    int strategyChoice = -1;
+                    try { strategyChoice = stoi(strategyChoiceStr); } catch(...) {}
+
+                    unique_ptr<RoutingStrategy> strategy; // Use smart pointer for strategy
+                    switch (strategyChoice) {
+                        case 1: strategy = make_unique<FastestRoute>(); break;
+                        case 2: strategy = make_unique<EmergencyRoute>(); break;
+                        default:
+                            cout << RED << "Invalid strategy. Defaulting to Fastest Route (Car).\n" << RESET;
+                            strategy = make_unique<FastestRoute>();
+                            break;
+                    }
+                    strategy->calculate(*this, src, dest); // Pass 'this' (the Graph object)
+                    break;
+                }
+                case 6: { // Compare Vehicle Routes (using Strategy Pattern)
+                    cout << "Enter source node for comparison: "; getline(cin, src);
+                    cout << "Enter destination node for comparison: "; getline(cin, dest);
+                    cout << YELLOW << "Comparing route for Car (Fastest) vs. Ambulance (Emergency):\n" << RESET;
+
+                    FastestRoute fastestStrategy;
+                    cout << BOLD << "\n--- Car Route ---\n" << RESET;
+                    fastestStrategy.calculate(*this, src, dest);
+
+                    EmergencyRoute emergencyStrategy;
+                    cout << BOLD << "\n--- Ambulance Route (Emergency Mode) ---\n" << RESET;
+                    emergencyStrategy.calculate(*this, src, dest);
+                    break;
+                }
+                case 7: { // Waypoint Routing (Limited)
+                    cout << YELLOW << "\nWaypoint routing is currently a direct path calculation. For multi-stop journeys, run shortest path multiple times.\n" << RESET;
+                    cout << "Enter source node: "; getline(cin, src);
+                    cout << "Enter destination node: "; getline(cin, dest);
+
+                    Vehicle car(CAR); // Default to car for this
+                    shortestPath(src, dest, car);
+                    break;
+                }
+                case 8: { // Save/Load Data
+                    cout << RED << "Save/Load functionality not implemented yet!\n" << RESET;
+                    break;
+                }
+                case 9: { // AI Traffic Analysis
+                    cout << "Enter start node for AI analysis: "; getline(cin, src);
+                    // Input Validation: Start node cannot be empty
+                    if (src.empty()) {
+                        cout << RED << "Error: Start node name cannot be empty!\n" << RESET;
+                        break;
+                    }
+                    cout << "Enter end node for AI analysis: "; getline(cin, dest);
+                    // Input Validation: End node cannot be empty
+                    if (dest.empty()) {
+                        cout << RED << "Error: End node name cannot be empty!\n" << RESET;
+                        break;
+                    }
+                    if (src == dest) {
+                        cout << RED << "Error: Start and end nodes cannot be the same for AI analysis.\n" << RESET;
+                        break;
+                    }
+                    ai.analyze(src, dest);
+                    predictRouteCongestion(src, dest);
+                    break;
+                }
+                case 10: { // Emergency Mode
+                    cout << BLUE << "Activating emergency siren (this is a simulation effect).\n" << RESET;
+                    playSiren();
+                    break;
+                }
+                case 11: { // City Traffic Statistics
+                    cout << MAGENTA << "\n=== CITY TRAFFIC STATISTICS ===\n" << RESET;
+                    cout << "Current Weather: " << getWeatherMessage() << endl;
+                    IncidentMonitor::getInstance().showActiveIncidents(); // Singleton access
+                    cout << "Time Multiplier: " << timeMultiplier << "x\n";
+                    // Add more stats for a richer experience
+                    cout << "Total Nodes in Map: " << adjList.size() << endl;
+                    int totalEdges = 0;
+                    for(const auto& nodePair : adjList) {
+                        totalEdges += nodePair.second.size();
+                    }
+                    cout << "Total Road Segments: " << totalEdges << endl;
+                    telemetry.showStatus();
+                    feed.showStatus();
+                    trips.showStatus();
+                    break;
+                }
+                case 13: { // Time Controls
+                    cout << "\n⏳ TIME CONTROLS:\n"
+                         << GREEN << "1. " << WHITE << "Pause (0x Speed)\n"
+                         << GREEN << "2. " << WHITE << "2x Speed\n"
+                         << GREEN << "3. " << WHITE << "5x Speed\n"
+                         << YELLOW << "4. " << WHITE << "Rewind (Not Implemented Yet)\n" // Not yet implemented
+                         << BOLD << "Choice: " << RESET;
+                    string choiceStr;
+                    getline(cin, choiceStr);
+                    int choice = -1;
+                    try { choice = stoi(choiceStr); } catch(...) {} // Safe conversion
+
+                    switch(choice) {
+                        case 1: timeMultiplier = 0; cout << YELLOW << "Time paused.\n" << RESET; break;
+                        case 2: timeMultiplier = 2; cout << YELLOW << "Time set to 2x speed.\n" << RESET; break;
+                        case 3: timeMultiplier = 5; cout << YELLOW << "Time set to 5x speed.\n" << RESET; break;
+                        case 4: cout << RED << "🔙 Rewind not implemented yet!\n" << RESET; break;
+                        default: cout << RED << "Invalid time control option!\n" << RESET; break;
+                    }
+                    break;
+                }
+                case 14: exportToCSV(); break; // Export Data
+                case 15: runTutorial(); break;  // Run Tutorial
+                case 17: { // Streaming Telemetry Export
+                    if (telemetry.active()) {
+                        telemetry.stop();
+                        cout << GREEN << "Telemetry stream stopped and flushed.\n" << RESET;
+                        telemetry.showStatus();
+                        break;
+                    }
+                    cout << "Format (1: Columnar .tscol, 2: CSV): ";
+                    string formatStr;
+                    getline(cin, formatStr);
+                    TelemetryFormat format = (formatStr == "2") ? TELEMETRY_CSV : TELEMETRY_COLUMNAR;
+                    bool compressColumns = false;
+                    if (format == TELEMETRY_COLUMNAR) {
+                        cout << "Compress columns (run-length/delta)? (y/n): ";
+                        string answer;
+                        getline(cin, answer);
+                        compressColumns = !answer.empty() && (answer[0] == 'y' || answer[0] == 'Y');
+                    }
+                    string path = (format == TELEMETRY_CSV) ? "traffic_stream" : "traffic_stream.tscol";
+                    if (!telemetry.start(format, path, compressColumns)) {
+                        cout << RED << "Error: Could not open " << path << " for appending. Check permissions.\n" << RESET;
+                        break;
+                    }
+                    cout << GREEN << "Streaming every tick to " << path
+                         << (format == TELEMETRY_CSV ? "_{edges,trips,incidents}.csv" : "")
+                         << ". Select option 17 again to stop.\n" << RESET;
+                    break;
+                }
+                case 18: { // Incident Feed Ingestion
+                    if (feed.active() || feed.finished()) {
+                        applyFeedEvents();
+                        feed.stop();
+                        cout << GREEN << "Incident feed stopped.\n" << RESET;
+                        feed.showStatus();
+                        break;
+                    }
+                    cout << "Feed source (file, named pipe, or unix:/path/to/socket): ";
+                    string source;
+                    getline(cin, source);
+                    cout << "Replay speed (feed seconds per real second, 0 = as fast as possible): ";
+                    string speedStr;
+                    getline(cin, speedStr);
+                    double speed = 0;
+                    try { speed = max(0.0, stod(speedStr)); } catch (...) {}
+                    if (source.empty() || !feed.start(source, speed)) {
+                        cout << RED << "Error: Could not open feed source '" << source << "'.\n" << RESET;
+                        break;
+                    }
+                    cout << GREEN << "Ingesting incident feed from " << source << ". Select option 18 again to stop.\n" << RESET;
+                    break;
+                }
+                case 19: { // Trips in Progress
+                    trips.showStatus();
+                    showReroutingStatus();
+                    cout << "\n" << GREEN << "1. " << WHITE << "Watch live progress\n"
+                         << GREEN << "2. " << WHITE << "Cancel a trip\n"
+                         << GREEN << "3. " << WHITE << "Cancel all trips\n"
+                         << BOLD << "Choice: " << RESET;
+                    string choiceStr;
+                    getline(cin, choiceStr);
+                    int choice = -1;
+                    try { choice = stoi(choiceStr); } catch(...) {} // Safe conversion
+
+                    switch (choice) {
+                        case 1:
+                            simulationLock.unlock(); // Trips may be re-routed while being watched
+                            trips.watch(); // Returns on Enter
+                            simulationLock.lock();
+                            break;
+                        case 2: {
+                            cout << "Trip number to cancel: ";
+                            string idStr;
+                            getline(cin, idStr);
+                            int id = -1;
+                            try { id = stoi(idStr); } catch(...) {}
+                            if (trips.cancel(id)) cout << YELLOW << "Trip #" << id << " cancelled.\n" << RESET;
+                            else cout << RED << "Error: No trip #" << idStr << " in progress.\n" << RESET;
+                            break;
+                        }
+                        case 3:
+                            cout << YELLOW << trips.cancelAll() << " trip(s) cancelled.\n" << RESET;
+                            break;
+                        default: cout << RED << "Invalid trip option!\n" << RESET; break;
+                    }
+                    break;
+                }
+                case 16: { // Traffic Assignment (OD Demand)
+                    cout << "Enter OD demand CSV (Origin,Destination,Trips; blank for sample demand): ";
+                    string demandFile;
+                    getline(cin, demandFile);
+                    DemandMatrix demand;
+                    if (demandFile.empty()) {
+                        demand = sampleDemand();
+                    } else if (!demand.loadFromCSV(demandFile)) {
+                        cout << RED << "Error: Could not open " << demandFile << " for reading.\n" << RESET;
+                        break;
+                    }
+                    if (demand.trips.empty()) {
+                        cout << RED << "Error: Demand matrix is empty.\n" << RESET;
+                        break;
+                    }
+                    cout << YELLOW << "Assigning " << fixed << setprecision(0) << demand.totalTrips()
+                         << " trips/hour over " << demand.trips.size() << " OD pairs...\n" << RESET;
+                    auto start_time = chrono::high_resolution_clock::now();
+                    AssignmentResult result = assignTraffic(demand, Vehicle(CAR));
+                    auto end_time = chrono::high_resolution_clock::now();
+                    showAssignmentReport(result);
+                    recordTrafficSnapshot();
+                    cout << "Assignment took: "
+                         << chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count() << "ms\n";
+                    cout << GREEN << "Edge flows and congested weights updated (export with option 14).\n" << RESET;
+                    break;
+                }
+                case 20: { // Monte Carlo What-If Runs
+                    cout << "Enter OD demand CSV (Origin,Destination,Trips; blank for sample demand): ";
+                    string demandFile, runsStr, seedStr;
+                    getline(cin, demandFile);
+                    DemandMatrix demand;
+                    if (!demandFile.empty() && !demand.loadFromCSV(demandFile)) {
+                        cout << RED << "Error: Could not open " << demandFile << " for reading.\n" << RESET;
+                        break;
+                    }
+                    int runs = 1000;
+                    uint64_t seed = 42;
+                    try {
+                        cout << "Number of runs (blank for 1000): ";
+                        getline(cin, runsStr);
+                        if (!runsStr.empty()) runs = stoi(runsStr);
+                        cout << "Seed (blank for 42): ";
+                        getline(cin, seedStr);
+                        if (!seedStr.empty()) seed = stoull(seedStr);
+                    } catch (const exception&) {
+                        cout << RED << "Invalid number input.\n" << RESET;
+                        break;
+                    }
+                    if (runs <= 0 || runs > 1000000) {
+                        cout << RED << "Error: Number of runs must be between 1 and 1000000.\n" << RESET;
+                        break;
+                    }
+                    unsigned threads = max(1u, thread::hardware_concurrency());
+                    cout << YELLOW << "Running " << runs << " scenarios on " << threads << " threads...\n" << RESET;
+                    auto start_time = chrono::high_resolution_clock::now();
+                    vector<MonteCarloRunner::Distribution> result = runScenarios(demand, Vehicle(CAR), runs, seed, threads);
+                    auto end_time = chrono::high_resolution_clock::now();
+                    MonteCarloRunner::showReport(result);
+                    cout << "Scenarios took: "
+                         << chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count() << "ms (seed " << seed
+                         << "; the same seed always gives the same table)\n";
+                    break;
+                }
+                case 21: { // Isochrones & Station Coverage
+                    cout << "Enter vehicle (car, bike, bus, ambulance, police, fire; '!' for emergency mode; blank for ambulance!): ";
+                    string vehicleName, sourcesLine, budgetStr;
+                    getline(cin, vehicleName);
+                    if (vehicleName.empty()) vehicleName = "ambulance!";
+                    VehicleType type;
+                    bool emergency;
+                    if (!parseVehicleName(vehicleName, type, emergency)) {
+                        cout << RED << "Error: Unknown vehicle " << vehicleName << ".\n" << RESET;
+                        break;
+                    }
+                    cout << "Enter source node(s), comma-separated (several give a coverage map): ";
+                    getline(cin, sourcesLine);
+                    int minutes = 8;
+                    try {
+                        cout << "Time budget in minutes (blank for 8): ";
+                        getline(cin, budgetStr);
+                        if (!budgetStr.empty()) minutes = stoi(budgetStr);
+                    } catch (const exception&) {
+                        cout << RED << "Invalid number input.\n" << RESET;
+                        break;
+                    }
+                    if (minutes <= 0) {
+                        cout << RED << "Error: Time budget must be positive.\n" << RESET;
+                        break;
+                    }
+                    shared_ptr<RoutingSnapshot> net = makeSnapshot(); // Current weather and incidents
+                    vector<int> sources;
+                    for (string name : splitFields(sourcesLine, ',')) {
+                        name.erase(0, name.find_first_not_of(' '));
+                        name.erase(name.find_last_not_of(' ') + 1);
+                        auto it = net->nodes->ids.find(name);
+                        if (it == net->nodes->ids.end()) {
+                            cout << RED << "Error: Unknown node '" << name << "'.\n" << RESET;
+                            sources.clear();
+                            break;
+                        }
+                        sources.push_back(it->second);
+                    }
+                    if (sources.empty()) break;
+                    Vehicle vehicle(type, emergency);
+                    if (sources.size() == 1) {
+                        showIsochrone(*net, computeIsochrone(*net, sources[0], minutes * 60, vehicle));
+                        break;
+                    }
+                    auto start_time = chrono::high_resolution_clock::now();
+                    ContractionHierarchy hierarchy(*net, vehicle);
+                    auto prepared_time = chrono::high_resolution_clock::now();
+                    ContractionHierarchy::Coverage coverage = hierarchy.coverage(sources, minutes * 60, max(1u, thread::hardware_concurrency()));
+                    auto end_time = chrono::high_resolution_clock::now();
+                    showCoverage(*net, sources, coverage, minutes * 60);
+                    cout << "Hierarchy: " << chrono::duration_cast<chrono::milliseconds>(prepared_time - start_time).count() << "ms ("
+                         << hierarchy.shortcutCount() << " shortcuts) | sweeps: "
+                         << chrono::duration_cast<chrono::microseconds>(end_time - prepared_time).count() << "us\n";
+                    break;
+                }
+                case 22: { // Trade-off Routes (Time / Toll / CO2)
+                    cout << "Enter source node: "; getline(cin, src);
+                    cout << "Enter destination node: "; getline(cin, dest);
+                    if (src == dest) {
+                        cout << RED << "Error: Source and destination are identical! No route needed.\n" << RESET;
+                        break;
+                    }
+                    cout << "Enter vehicle (car, bike, bus, ambulance, police, fire; '!' for emergency mode; blank for car): ";
+                    string vehicleName, weightsLine;
+                    getline(cin, vehicleName);
+                    if (vehicleName.empty()) vehicleName = "car";
+                    VehicleType type;
+                    bool emergency;
+                    if (!parseVehicleName(vehicleName, type, emergency)) {
+                        cout << RED << "Error: Unknown vehicle " << vehicleName << ".\n" << RESET;
+                        break;
+                    }
+                    cout << "Seconds worth one $ of toll and one kg of CO2, e.g. '60 30' (blank for every trade-off): ";
+                    getline(cin, weightsLine);
+                    if (weightsLine.empty()) {
+                        showParetoRoutes(src, dest, Vehicle(type, emergency));
+                        break;
+                    }
+                    double secondsPerDollar, secondsPerKg;
+                    stringstream weights(weightsLine);
+                    if (!(weights >> secondsPerDollar >> secondsPerKg) || secondsPerDollar <= 0 || secondsPerKg <= 0) {
+                        cout << RED << "Invalid weights. Enter two positive numbers.\n" << RESET;
+                        break;
+                    }
+                    showWeightedRoute(src, dest, Vehicle(type, emergency), secondsPerDollar, secondsPerKg);
+                    break;
+                }
+                default: cout << RED << "Invalid Option! Please select a number from the menu.\n" << RESET;
+            }
+            // Pause before showing the menu again to allow user to read output
+            refreshSubscriptions(); // Re-route around whatever the option changed (closures, rush hour, ...)
+            trips.showArrivals();   // Announced here rather than from the playback thread, so prompts stay intact
+            showRerouteNotices();   // Likewise for the re-routing watcher
+            cout << "\n" << BOLD << "Press Enter to continue..." << RESET;
+            simulationLock.unlock();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear input buffer and wait for Enter
+            simulationLock.lock();
+        }
+        simulationLock.unlock();
+        menuRunning = false;
+        rerouteWatcher.join();
+    }
+private:
+    // Adds a set of predefined roads to the graph for initial setup
+    void addDefaultRoads() {
+        // Highway system
+        addRoad("Downtown", "Midtown", 300, 60, "Highway");
+        addRoad("Midtown", "Uptown", 400, 80, "Highway");
+        addRoad("Downtown", "Airport", 500, 120, "Highway");
+
+        // City streets
+        addRoad("Downtown", "Market St", 120, 30, "General");
+        addRoad("Market St", "City Hall", 90, 20, "General");
+        addRoad("City Hall", "Uptown", 180, 40, "General");
+        addRoad("Downtown", "Residential Area", 150, 25, "General");
+        addRoad("Market St", "Industrial Zone", 250, 50, "General");
+
+        // Special routes
+        addRoad("Midtown", "Bike Trail", 150, 10, "Bike Lane"); // Renamed for clarity
+        addRoad("City Hall", "Bus Terminal", 200, 30, "Bus Lane");
+        addRoad("Airport", "Emergency Hospital", 100, 10, "Emergency"); // New emergency specific road
+        addRoad("Uptown", "Suburban Tunnel", 350, 70, "Tunnel");
+        addRoad("Residential Area", "Central Bridge", 200, 40, "Bridge");
+
+        cout << CYAN << "Default roads loaded.\n" << RESET;
+    }
+
+    // Morning-peak style demand between the default districts, used when no OD file is given
+    DemandMatrix sampleDemand() {
+        DemandMatrix demand;
+        demand.add("Residential Area", "Downtown", 900);
+        demand.add("Residential Area", "Industrial Zone", 400);
+        demand.add("Central Bridge", "Downtown", 600);
+        demand.add("Suburban Tunnel", "Downtown", 700);
+        demand.add("Uptown", "Market St", 500);
+        demand.add("Uptown", "Airport", 300);
+        demand.add("Bus Terminal", "Downtown", 350);
+        demand.add("Midtown", "Industrial Zone", 450);
+        demand.add("Airport", "City Hall", 250);
+        return demand;
+    }
+
+    // Applies weather effects to road weights based on current weather conditions.
+    // IMPORTANT: This now correctly uses the 'baseEdges' to get the original weight
+    // and then applies the weather multiplier, preventing compounding effects.
+    // Skips the pass entirely when the same weather is already applied and nothing else
+    // (rush hour, assignment, new roads) has touched the weights since.
+    void applyWeatherEffects() {
+        if (appliedWeather == currentWeather) return;
+        double weatherMult = getWeatherMultiplier();
+        for (auto& nodePair : adjList) {
+            for (auto& edge : nodePair.second) {
+                // Apply weather multiplier to the original base weight and update the edge's current weight
+                edge.weight = edge.baseWeight / weatherMult;
+            }
+        }
+        appliedWeather = currentWeather;
+    }
+
+    // Cost of an edge before the vehicle's speed is applied, as searchKernel computes it; -1 when closed.
+    double watchedBaseCost(const Edge& edge) const {
+        if (edge.blocked || incidentClosed[edge.id]) return -1;
+        double effectiveWeight = edge.weight;
+        effectiveWeight *= (1.0 + (edge.congestion * 0.1));
+        return effectiveWeight + edge.signalDelay;
+    }
+
+    void snapshotWatchedCosts() {
+        refreshIncidentClosures();
+        watchedWeather = currentWeather;
+        watchedCost.resize(edgeCount);
+        for (int e = 0; e < edgeCount; ++e) watchedCost[e] = watchedBaseCost(edgeById(e));
+    }
+
+    int vehicleCost(const Edge& edge, const RuntimeVehiclePolicy& policy) const {
+        double base = watchedBaseCost(edge);
+        if (base < 0 || (edge.roadBit & policy.roadMask()) == 0) return ROUTE_UNREACHABLE;
+        return static_cast<int>(base / policy.speed());
+    }
+
+    // Half of partitionNodes: gives nodes[] the shards firstPart .. firstPart + parts - 1. 'member'
+    // and 'seen' are per-node stamps (compared against 'stamp') reused down the recursion.
+    void bisectNodes(const vector<int>& nodes, int firstPart, int parts, vector<int>& part,
+                     vector<int>& member, vector<int>& seen, int& stamp) {
+        if (parts == 1 || nodes.size() <= 1) {
+            for (int v : nodes) part[v] = firstPart;
+            return;
+        }
+        int inSet = ++stamp;
+        for (int v : nodes) member[v] = inSet;
+        vector<int> order;
+        // Breadth-first order of the subset from 'start', continuing with the next unseen node
+        // whenever a component is exhausted
+        auto bfs = [&](int start) {
+            int visited = ++stamp;
+            order.clear();
+            size_t next = 0;
+            for (size_t k = 0; order.size() < nodes.size(); ++k) {
+                if (k == order.size()) {
+                    int root = start;
+                    if (seen[root] == visited) {
+                        while (seen[nodes[next]] == visited) ++next;
+                        root = nodes[next];
+                    }
+                    seen[root] = visited;
+                    order.push_back(root);
+                }
+                for (const Edge& edge : *nodeEdges[order[k]]) {
+                    if (member[edge.to] == inSet && seen[edge.to] != visited) {
+                        seen[edge.to] = visited;
+                        order.push_back(edge.to);
+                    }
+                }
+            }
+        };
+        bfs(nodes[0]);
+        bfs(order.back()); // The last node reached is on the periphery
+
+        int leftParts = parts / 2;
+        size_t leftSize = nodes.size() * leftParts / parts;
+        vector<int> left(order.begin(), order.begin() + leftSize), right(order.begin() + leftSize, order.end());
+        bisectNodes(left, firstPart, leftParts, part, member, seen, stamp);
+        bisectNodes(right, firstPart + leftParts, parts - leftParts, part, member, seen, stamp);
+    }
+
+    // Simulated traffic on the given roads: congestion on about one in eight drifts one level up or
+    // down. Deterministic for a seed; returns the number of roads that changed.
+    int driftCongestion(const vector<int>& roads, uint32_t seed) {
+        mt19937 rng(seed);
+        int changed = 0;
+        for (int e : roads) {
+            if (rng() % 8) continue;
+            Edge& edge = edgeById(e);
+            int level = min(MAX_CONGESTION, max(0, edge.congestion + (rng() % 2 ? 1 : -1)));
+            if (level != edge.congestion) ++changed;
+            edge.congestion = level;
+        }
+        return changed;
+    }
+
+    // Full Dijkstra towards sub.dest over reversed edges: the in-edges of x are the twins (id ^ 1)
+    // of its out-edges.
+    void growTree(RouteSubscription& sub) {
+        const int n = static_cast<int>(nodeNames.size());
+        sub.cost.resize(edgeCount);
+        for (int e = 0; e < edgeCount; ++e) sub.cost[e] = vehicleCost(edgeById(e), sub.policy);
+        sub.dist.assign(n, ROUTE_UNREACHABLE);
+        sub.nextNode.assign(n, -1);
+        sub.nextEdge.assign(n, -1);
+        sub.dist[sub.dest] = 0;
+        DefaultRouteQueue& queue = pooledQueue<DefaultRouteQueue>();
+        queue.reset(n);
+        queue.push(0, sub.dest);
+        settleTree(sub, queue);
+    }
+
+    // Dijkstra relaxation of predecessors shared by growTree and repairTree.
+    template <class Queue>
+    void settleTree(RouteSubscription& sub, Queue& queue) {
+        while (!queue.empty()) {
+            pair<int, int> current = queue.pop();
+            int x = current.second;
+            if (current.first > sub.dist[x]) continue;
+            for (const Edge& out : *nodeEdges[x]) {
+                int in = out.id ^ 1; // out.to -> x
+                if (sub.cost[in] == ROUTE_UNREACHABLE) continue;
+                int candidate = current.first + sub.cost[in];
+                if (candidate < sub.dist[out.to]) {
+                    sub.dist[out.to] = candidate;
+                    sub.nextNode[out.to] = x;
+                    sub.nextEdge[out.to] = in;
+                    queue.push(candidate, out.to);
+                }
+            }
+        }
+    }
+
+    // Incremental update after the edges in 'changed' got worse or better: the subtrees hanging
+    // off worsened tree edges are cut loose, re-seeded from their intact neighbours, and Dijkstra
+    // then runs only from the seeds and from the tails of improved edges. Returns false when none
+    // of the changes affects this tree.
+    bool repairTree(RouteSubscription& sub, const vector<int>& changed) {
+        vector<int> cutRoots, improved;
+        for (int e : changed) {
+            int before = sub.cost[e], now = vehicleCost(edgeById(e), sub.policy);
+            if (before == now) continue;
+            sub.cost[e] = now;
+            int tail = edgeSlots[e].first;
+            if (now > before && sub.nextEdge[tail] == e) cutRoots.push_back(tail);
+            else if (now < before) improved.push_back(e);
+        }
+        if (cutRoots.empty() && improved.empty()) return false;
+
+        // Collect every node whose tree path used a worsened edge
+        vector<char> cut(nodeNames.size(), 0);
+        vector<int> cutNodes;
+        while (!cutRoots.empty()) {
+            int x = cutRoots.back();
+            cutRoots.pop_back();
+            if (cut[x]) continue;
+            cut[x] = 1;
+            cutNodes.push_back(x);
+            for (const Edge& out : *nodeEdges[x]) {
+                if (sub.nextEdge[out.to] == (out.id ^ 1)) cutRoots.push_back(out.to); // out.to routes through x
+            }
+        }
+        for (int x : cutNodes) { sub.dist[x] = ROUTE_UNREACHABLE; sub.nextNode[x] = -1; sub.nextEdge[x] = -1; }
+
+        BinaryHeapQueue& queue = pooledQueue<BinaryHeapQueue>(); // Seeds have arbitrary keys
+        queue.reset(nodeNames.size());
+        for (int x : cutNodes) { // Best way back into the intact part of the tree
+            for (const Edge& out : *nodeEdges[x]) {
+                if (cut[out.to] || sub.dist[out.to] == ROUTE_UNREACHABLE || sub.cost[out.id] == ROUTE_UNREACHABLE) continue;
+                int candidate = sub.cost[out.id] + sub.dist[out.to];
+                if (candidate < sub.dist[x]) { sub.dist[x] = candidate; sub.nextNode[x] = out.to; sub.nextEdge[x] = out.id; }
+            }
+            if (sub.dist[x] != ROUTE_UNREACHABLE) queue.push(sub.dist[x], x);
+        }
+        for (int e : improved) {
+            const Edge& edge = edgeById(e);
+            int tail = edgeSlots[e].first;
+            if (sub.dist[edge.to] == ROUTE_UNREACHABLE || sub.cost[e] == ROUTE_UNREACHABLE) continue;
+            int candidate = sub.cost[e] + sub.dist[edge.to];
+            if (candidate < sub.dist[tail]) {
+                sub.dist[tail] = candidate;
+                sub.nextNode[tail] = edge.to;
+                sub.nextEdge[tail] = e;
+                queue.push(candidate, tail);
+            }
+        }
+        settleTree(sub, queue);
+        return true;
+    }
+
+    // Re-plans a trip from the next node it reaches, if its repaired tree offers a different
+    // route or a different arrival time from there.
+    void replan(RouteSubscription& sub, double elapsed, chrono::high_resolution_clock::time_point changeSeen) {
+        // Where the trip is: the next plan node it has not reached yet (trips never turn mid-road)
+        double along = elapsed - sub.planStart;
+        size_t at = 0;
+        while (at + 1 < sub.planArrival.size() && sub.planArrival[at] < along) ++at;
+        int node = sub.planNodes[at];
+        double toNode = max(0.0, sub.planArrival[at] - along);
+
+        if (sub.dist[node] == ROUTE_UNREACHABLE) {
+            if (!sub.stranded) {
+                ostringstream notice;
+                notice << RED << "\n⚠️ Trip #" << sub.trip << " (" << sub.label << ") has no open route left from "
+                       << nodeNames[node] << "; continuing on its planned roads.\n" << RESET;
+                rerouteNotices.push_back(notice.str());
+            }
+            sub.stranded = true;
+            return;
+        }
+        sub.stranded = false;
+
+        vector<int> nodes(1, node), arrival(1, 0);
+        for (int x = node; x != sub.dest; x = sub.nextNode[x]) {
+            nodes.push_back(sub.nextNode[x]);
+            arrival.push_back(arrival.back() + sub.cost[sub.nextEdge[x]]);
+        }
+        bool sameRoads = equal(nodes.begin(), nodes.end(), sub.planNodes.begin() + at, sub.planNodes.end());
+        int oldRemaining = sub.planArrival.back() - sub.planArrival[at];
+        if (sameRoads && arrival.back() == oldRemaining) return;
+
+        sub.planNodes.swap(nodes);
+        sub.planArrival.swap(arrival);
+        sub.planStart = elapsed + toNode;
+        trips.reschedule(sub.trip, static_cast<int>(ceil(sub.planStart)) + sub.planArrival.back());
+        if (sameRoads) return; // Only the arrival time moved; the progress bar shows it
+
+        ++reroutes;
+        double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - changeSeen).count();
+        ostringstream notice;
+        notice << YELLOW << "\n🔀 Trip #" << sub.trip << " (" << sub.label << ") re-routed at " << nodeNames[node] << ": ";
+        for (size_t i = 0; i < sub.planNodes.size(); ++i) notice << (i ? " -> " : "") << nodeNames[sub.planNodes[i]];
+        notice << " | " << showpos << (sub.planArrival.back() - oldRemaining) << noshowpos << "s ("
+               << fixed << setprecision(2) << ms << " ms after the change)\n" << RESET;
+        rerouteNotices.push_back(notice.str()); // The watcher thread may be here while the menu waits for input
+    }
+
+    // {origin id, [{destination id, trips/hour}]}
+    typedef pair<int, vector<pair<int, double>>> OriginDemand;
+
+    // All-or-nothing loading: every origin's demand goes onto its shortest paths under 'times'.
+    // Origins are split round-robin across worker threads, each accumulating into its own
+    // flow vector; the partial vectors are summed in a fixed order so results are deterministic.
+    // Returns the demand that could not reach its destination.
+    double allOrNothing(const vector<OriginDemand>& origins, const vector<double>& times,
+                        const vector<char>& usable, vector<double>& flow) {
+        const int n = static_cast<int>(nodeNames.size());
+        unsigned workers = max(1u, min(thread::hardware_concurrency(), static_cast<unsigned>(origins.size())));
+        vector<vector<double>> partialFlow(workers, vector<double>(edgeCount, 0.0));
+        vector<double> partialUnassigned(workers, 0.0);
+
+        auto work = [&](unsigned worker) {
+            vector<double> dist(n);
+            vector<int> parentEdge(n), parentNode(n);
+            typedef pair<double, int> QueueEntry;
+            for (size_t i = worker; i < origins.size(); i += workers) {
+                int origin = origins[i].first;
+                fill(dist.begin(), dist.end(), numeric_limits<double>::infinity());
+                fill(parentEdge.begin(), parentEdge.end(), -1);
+                priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> pq;
+                dist[origin] = 0;
+                pq.push({0.0, origin});
+                while (!pq.empty()) {
+                    QueueEntry top = pq.top();
+                    pq.pop();
+                    int u = top.second;
+                    if (top.first > dist[u]) continue;
+                    for (const Edge& edge : *nodeEdges[u]) {
+                        if (!usable[edge.id]) continue;
+                        double candidate = dist[u] + times[edge.id];
+                        if (candidate < dist[edge.to]) {
+                            dist[edge.to] = candidate;
+                            parentEdge[edge.to] = edge.id;
+                            parentNode[edge.to] = u;
+                            pq.push({candidate, edge.to});
+                        }
+                    }
+                }
+                for (const auto& destination : origins[i].second) {
+                    if (dist[destination.first] == numeric_limits<double>::infinity()) {
+                        partialUnassigned[worker] += destination.second;
+                        continue;
+                    }
+                    for (int v = destination.first; v != origin; v = parentNode[v]) {
+                        partialFlow[worker][parentEdge[v]] += destination.second;
+                    }
+                }
+            }
+        };
+
+        vector<thread> pool;
+        for (unsigned w = 1; w < workers; ++w) pool.emplace_back(work, w);
+        work(0);
+        for (auto& t : pool) t.join();
+
+        flow.assign(edgeCount, 0.0);
+        double unassigned = 0;
+        for (unsigned w = 0; w < workers; ++w) {
+            for (int e = 0; e < edgeCount; ++e) flow[e] += partialFlow[w][e];
+            unassigned += partialUnassigned[w];
+        }
+        return unassigned;
+    }
+
+    // Synthetic side x side grid city for tests and benchmarks: every 10th street is a highway,
+    // the rest are general roads with random lengths and signal delays.
+    void addGridCity(int side, unsigned seed) {
+        mt19937 rng(seed);
+        uniform_int_distribution<int> length(30, 300), signal(0, 60);
+        auto name = [](int r, int c) { return "G" + to_string(r) + "_" + to_string(c); };
+        for (int r = 0; r < side; ++r) {
+            for (int c = 0; c < side; ++c) {
+                if (c + 1 < side) addRoad(name(r, c), name(r, c + 1), length(rng), signal(rng), r % 10 == 0 ? "Highway" : "General", false);
+                if (r + 1 < side) addRoad(name(r, c), name(r + 1, c), length(rng), signal(rng), c % 10 == 0 ? "Highway" : "General", false);
+            }
+        }
+    }
+
+    // Hands the journey to the trip player and returns its trip id immediately; progress shows
+    // under option 19.
+    int simulateTimeDelay(const string& label, int seconds) {
+        int id = trips.start(label, seconds);
+        cout << CYAN << "\nSimulating journey (" << seconds << " seconds) as trip #" << id
+             << " in the background (option 19 to watch or cancel).\n" << RESET;
+        return id;
+    }
+
+    // Unit Test Scaffolding
+    #ifdef TESTING
+    public: // Making public for external test access
+    // Returns the number of failed checks; each one also prints a red "Test N failed" line.
+    static int runTests() {
+        Graph testGraph;
+        int failures = 0;
+        auto fail = [&failures]() -> ostream& { ++failures; return cout << RED; };
+        cout << GREEN << "\n=== Running Unit Tests ===\n" << RESET;
+
+        // Test 1: Add road and basic shortest path
+        testGraph.addRoad("TestA", "TestB", 100, 0);
+        Vehicle testCar(CAR);
+        testGraph.shortestPath("TestA", "TestB", testCar);
+
+        // Test 2: Edge case - same source and destination
+        testGraph.shortestPath("TestA", "TestA", testCar);
+
+        // Test 3: Edge case - non-existent node
+        testGraph.shortestPath("TestA", "NonExistent", testCar);
+
+        // Test 4: Check if Singleton IncidentMonitor is working
+        IncidentMonitor::getInstance().generateIncident();
+        IncidentMonitor::getInstance().showActiveIncidents();
+
+        // Test 5: Strategy pattern
+        FastestRoute().calculate(testGraph, "TestA", "TestB");
+        EmergencyRoute().calculate(testGraph, "TestA", "TestB");
+
+        // Test 6: Traffic assignment splits demand between two parallel routes at equilibrium
+        Graph assignGraph;
+        assignGraph.addRoad("O", "M1", 100, 0, "Highway");
+        assignGraph.addRoad("M1", "D", 100, 0, "Highway");
+        assignGraph.addRoad("O", "M2", 120, 0, "Highway");
+        assignGraph.addRoad("M2", "D", 120, 0, "Highway");
+        DemandMatrix demand;
+        demand.add("O", "D", 3000);
+        AssignmentResult result = assignGraph.assignTraffic(demand, Vehicle(CAR));
+        double viaM1 = 0, viaM2 = 0;
+        for (const Edge& edge : assignGraph.adjList.at("O")) {
+            if (edge.destination == "M1") viaM1 = edge.flow;
+            if (edge.destination == "M2") viaM2 = edge.flow;
+        }
+        cout << "Assignment: " << result.iterations << " iterations, gap " << result.relativeGap
+             << ", flows " << viaM1 << "/" << viaM2 << "\n";
+        if (viaM1 <= viaM2 || viaM2 <= 0 || fabs(viaM1 + viaM2 - 3000) > 1e-6) {
+            fail() << "Test 6 failed: expected both routes loaded, shorter one more heavily.\n" << RESET;
+        }
+        Route assigned;
+        int congestedTime = 0;
+        bool assignedRouted = assignGraph.computeRoute("O", "D", Vehicle(CAR), assigned);
+        for (int id : assigned.edgeIds) {
+            const Edge& edge = assignGraph.edgeById(id);
+            congestedTime += static_cast<int>(volumeDelay(edge.baseWeight / getWeatherMultiplier(), edge.flow, getRoadCapacity(edge.roadType)));
+        }
+        if (!assignedRouted || assigned.totalTime != congestedTime) {
+            fail() << "Test 6 failed: route after assignment costs " << assigned.totalTime << "s, expected " << congestedTime << "s.\n" << RESET;
+        }
+        AssignmentResult repeated = assignGraph.assignTraffic(demand, Vehicle(CAR));
+        if (fabs(repeated.totalTravelTime - result.totalTravelTime) > 1e-6 * result.totalTravelTime) {
+            fail() << "Test 6 failed: repeating the assignment changed total travel time from " << result.totalTravelTime
+                   << " to " << repeated.totalTravelTime << ".\n" << RESET;
+        }
+
+        // Test 7: Edge history stays bounded and tracks a level shift
+        EdgeHistory history;
+        for (int i = 0; i < 3 * HISTORY_CAPACITY; ++i) history.record(1000 + i, 8, i < 100 ? 60.0 : 120.0, i < 100 ? 0 : 4);
+        EdgeHistory::Forecast nowcast = history.forecast(8, 0, 0);
+        cout << "History: " << history.size() << " samples, newest " << history.recent(0).travelTime
+             << "s, EWMA " << history.averageTravelTime() << "s, nowcast " << nowcast.travelTime << "s\n";
+        if (history.size() != HISTORY_CAPACITY || fabs(history.averageTravelTime() - 120.0) > 1e-3) {
+            fail() << "Test 7 failed: history not bounded or EWMA not converged.\n" << RESET;
+        }
+
+        // Test 8: SPSC ring refuses pushes when full and preserves order across wrap-around
+        SpscRing<int> ring(3); // Rounded up to 4 slots
+        int pushed = 0, value = 0;
+        for (int i = 0; i < 6; ++i) { int item = i; if (ring.tryPush(item)) ++pushed; }
+        bool ordered = ring.tryPop(value) && value == 0;
+        int item = 99;
+        ordered = ordered && ring.tryPush(item);
+        for (int expected : {1, 2, 3, 99}) ordered = ordered && ring.tryPop(value) && value == expected;
+        if (pushed != 4 || !ordered || ring.tryPop(value)) {
+            fail() << "Test 8 failed: SPSC ring capacity or ordering is wrong.\n" << RESET;
+        }
+
+        // Test 9: Feed replay closes a road and indexes an incident
+        string feedPath = "feed_test.txt";
+        {
+            ofstream feedFile(feedPath);
+            feedFile << "# recorded feed\n0,CLOSURE,TestA,TestB\n1,INCIDENT,TestB,General,2,Test Flood\nbad line\n";
+        }
+        testGraph.feed.start(feedPath, 0);
+        for (int i = 0; i < 200 && !testGraph.feed.finished(); ++i) this_thread::sleep_for(chrono::milliseconds(5));
+        testGraph.applyFeedEvents();
+        testGraph.feed.showStatus();
+        testGraph.feed.stop();
+        remove(feedPath.c_str());
+        bool closed = testGraph.adjList.at("TestA").front().blocked;
+        if (!closed || !IncidentMonitor::getInstance().blocksRoad("TestA", "TestB", "General", "General")) {
+            fail() << "Test 9 failed: feed events were not applied.\n" << RESET;
+        }
+
+        // Test 10: Warmed-up route queries perform no heap allocations
+        Graph queryGraph;
+        queryGraph.addDefaultRoads();
+        Route route;
+        Vehicle queryCar(CAR);
+        const string residential = "Residential Area", tunnel = "Suburban Tunnel", airport = "Airport", industrial = "Industrial Zone";
+        queryGraph.computeRoute(residential, tunnel, queryCar, route); // Warm-up
+        size_t allocationsBefore = testAllocations;
+        bool allFound = true;
+        for (int i = 0; i < 100; ++i) {
+            allFound = queryGraph.computeRoute(residential, tunnel, queryCar, route) && allFound;
+            allFound = queryGraph.computeRoute(airport, industrial, queryCar, route) && allFound;
+        }
+        size_t queryAllocations = testAllocations - allocationsBefore;
+        cout << "Steady-state queries: " << queryAllocations << " allocations over 200 routes\n";
+        if (!allFound || queryAllocations != 0) {
+            fail() << "Test 10 failed: route queries allocate or fail.\n" << RESET;
+        }
+
+        // Test 11: Every priority queue finds the same shortest distances
+        Graph gridGraph;
+        gridGraph.addGridCity(30, 7);
+        gridGraph.applyWeatherEffects();
+        QueryWorkspace& ws = queryWorkspace();
+        mt19937 pick(11);
+        bool queuesAgree = true;
+        for (int i = 0; i < 50; ++i) {
+            int a = pick() % gridGraph.nodeNames.size(), b = pick() % gridGraph.nodeNames.size();
+            int reference = gridGraph.searchRoute(a, b, queryCar, ws, pooledQueue<BinaryHeapQueue>());
+            queuesAgree = queuesAgree
+                && gridGraph.searchRoute(a, b, queryCar, ws, pooledQueue<IndexedDaryHeap<4>>()) == reference
+                && gridGraph.searchRoute(a, b, queryCar, ws, pooledQueue<DialQueue>()) == reference
+                && gridGraph.searchRoute(a, b, queryCar, ws, pooledQueue<RadixHeapQueue>()) == reference;
+        }
+        DialQueue& dial = pooledQueue<DialQueue>();
+        dial.reset(3);
+        dial.push(0, 0);
+        dial.push(5000, 1); // Beyond the initial bucket range: forces a grow
+        dial.push(3000, 2);
+        queuesAgree = queuesAgree && dial.pop() == make_pair(0, 0) && dial.pop() == make_pair(3000, 2)
+            && dial.pop() == make_pair(5000, 1) && dial.empty();
+        // Keys far beyond MAX_BUCKETS wait in the overflow list instead of growing the window
+        dial.reset(4);
+        dial.push(0, 0);
+        dial.push(2000000000, 1);
+        dial.push(1000000000, 2);
+        dial.push(1000000100, 3);
+        dial.push(1500000000, 1); // Decrease-key inside the overflow list
+        queuesAgree = queuesAgree && dial.pop() == make_pair(0, 0) && dial.pop() == make_pair(1000000000, 2)
+            && dial.pop() == make_pair(1000000100, 3) && dial.pop() == make_pair(1500000000, 1) && dial.empty()
+            && dial.buckets() <= DialQueue::MAX_BUCKETS;
+        Graph slowGraph;
+        slowGraph.addRoad("SlowA", "SlowB", 1000000000, 0, "General", false);
+        slowGraph.addRoad("SlowB", "SlowC", 60, 0, "General", false);
+        slowGraph.addRoad("SlowA", "SlowD", 30, 0, "General", false);
+        slowGraph.applyWeatherEffects();
+        for (int target = 1; target < 4; ++target) {
+            queuesAgree = queuesAgree && slowGraph.searchRoute(0, target, queryCar, ws, pooledQueue<DialQueue>())
+                == slowGraph.searchRoute(0, target, queryCar, ws, pooledQueue<BinaryHeapQueue>());
+        }
+        queuesAgree = queuesAgree && pooledQueue<DialQueue>().buckets() <= DialQueue::MAX_BUCKETS;
+        if (!queuesAgree) fail() << "Test 11 failed: priority queues disagree on distances.\n" << RESET;
+
+        // Test 12: Compile-time vehicle kernels match the runtime policy on every default road pair
+        queryGraph.refreshIncidentClosures();
+        bool kernelsAgree = true;
+        for (int type = CAR; type <= FIRE_TRUCK; ++type) {
+            for (bool emergency : {false, true}) {
+                Vehicle vehicle(static_cast<VehicleType>(type), emergency);
+                int n = static_cast<int>(queryGraph.nodeNames.size());
+                for (int a = 0; a < n; ++a) {
+                    for (int b = 0; b < n; ++b) {
+                        kernelsAgree = kernelsAgree && queryGraph.searchRoute(a, b, vehicle, ws, pooledQueue<DialQueue>())
+                            == queryGraph.searchKernel(a, b, RuntimeVehiclePolicy(vehicle), ws, pooledQueue<DialQueue>());
+                    }
                 }
-                case 2: // View Map (Basic) - now points to Enhanced Map
-                case 12: { // Enhanced Live Map
-                    showEnhancedMap();
-                    break;
+            }
+        }
+        if (!kernelsAgree) fail() << "Test 12 failed: specialised kernels disagree with the runtime policy.\n" << RESET;
+
+        // Test 13: Trip playback runs in the background and can be cancelled
+        Graph tripGraph;
+        tripGraph.addRoad("TripA", "TripB", 600, 0, "General", false);
+        tripGraph.trips.useManualClock();
+        auto tripStart = chrono::steady_clock::now();
+        tripGraph.shortestPath("TripA", "TripB", testCar);
+        bool returnedAtOnce = chrono::steady_clock::now() - tripStart < chrono::seconds(1);
+        int shortTrip = tripGraph.trips.start("short trip", 1);
+        tripGraph.trips.advance(4);
+        vector<TripPlayer::TripStatus> inFlight = tripGraph.trips.activeTrips();
+        vector<string> arrived = tripGraph.trips.takeArrivals();
+        bool playedBack = inFlight.size() == 1 && inFlight[0].duration == 600 && inFlight[0].elapsed == 4 && inFlight[0].id != shortTrip
+            && arrived.size() == 1 && arrived[0].find("short trip") != string::npos && tripGraph.trips.takeArrivals().empty();
+        bool cancelled = tripGraph.trips.cancel(inFlight.empty() ? -1 : inFlight[0].id) && tripGraph.trips.activeTrips().empty();
+        if (!returnedAtOnce || !playedBack || !cancelled) {
+            fail() << "Test 13 failed: trip playback blocked, stalled or could not be cancelled.\n" << RESET;
+        }
+
+        // Test 14: A routing snapshot answers exactly like the live graph
+        shared_ptr<RoutingSnapshot> frozen = queryGraph.makeSnapshot();
+        bool snapshotAgrees = true;
+        for (int type = CAR; type <= FIRE_TRUCK; ++type) {
+            Vehicle vehicle(static_cast<VehicleType>(type), type >= AMBULANCE);
+            for (const string& a : queryGraph.nodeNames) {
+                for (const string& b : queryGraph.nodeNames) {
+                    if (a == b) continue;
+                    bool found = queryGraph.computeRoute(a, b, vehicle, route);
+                    int time = frozen->search(frozen->nodes->ids.at(a), frozen->nodes->ids.at(b), vehicle, ws);
+                    snapshotAgrees = snapshotAgrees && (found ? time == route.totalTime && ws.pathNodes == route.nodes : time < 0);
                 }
-                case 3: { // Simulate/View Incidents
-                    IncidentMonitor::getInstance().generateIncident(); // Generate a new incident (Singleton access)
-                    IncidentMonitor::getInstance().showActiveIncidents(); // Show all active incidents (Singleton access)
-                    break;
+            }
+        }
+        shared_ptr<RoutingSnapshot> beforeClosure = tripGraph.makeSnapshot();
+        tripGraph.setRoadBlocked("TripA", "TripB", true);
+        shared_ptr<RoutingSnapshot> afterClosure = tripGraph.makeSnapshot();
+        tripGraph.addRoad("TripB", "TripC", 60, 0, "General", false);
+        shared_ptr<RoutingSnapshot> afterNewNode = tripGraph.makeSnapshot();
+        snapshotAgrees = snapshotAgrees && beforeClosure->nodes == afterClosure->nodes && afterClosure->arcs.size() + 2 == beforeClosure->arcs.size()
+            && afterNewNode->nodes != afterClosure->nodes && afterNewNode->nodes->ids.at("TripC") == 2;
+        if (!snapshotAgrees) fail() << "Test 14 failed: routing snapshot disagrees with the live graph.\n" << RESET;
+
+        // Test 16: Repaired shortest-path trees match fresh ones, and blocked trips are re-routed
+        Graph rerouteGraph;
+        rerouteGraph.addGridCity(20, 5);
+        Route trip;
+        rerouteGraph.computeRoute("G2_2", "G17_15", testCar, trip);
+        int tripId = rerouteGraph.trips.start("reroute test", trip.totalTime);
+        rerouteGraph.subscribeRoute(tripId, testCar, trip);
+        // Close the third road of the planned route; the trip has not reached it yet
+        string closedFrom = rerouteGraph.nodeNames[trip.nodes[2]], closedTo = rerouteGraph.nodeNames[trip.nodes[3]];
+        rerouteGraph.setRoadBlocked(closedFrom, closedTo, true);
+        rerouteGraph.refreshSubscriptions();
+        const RouteSubscription& live = rerouteGraph.subscriptions.at(tripId);
+        bool rerouted = rerouteGraph.reroutes == 1 && rerouteGraph.rerouteNotices.size() == 1
+            && rerouteGraph.rerouteNotices[0].find("re-routed at") != string::npos;
+        rerouteGraph.rerouteNotices.clear();
+        for (size_t i = 0; i + 1 < live.planNodes.size(); ++i) {
+            rerouted = rerouted && !(live.planNodes[i] == trip.nodes[2] && live.planNodes[i + 1] == trip.nodes[3]);
+        }
+        mt19937 churn(16);
+        bool treesAgree = true;
+        for (int round = 0; round < 20; ++round) {
+            for (int k = 0; k < 5; ++k) { // Random closures, reopenings and congestion changes
+                Edge& edge = rerouteGraph.edgeById(churn() % rerouteGraph.edgeCount);
+                if (k % 2) edge.congestion = churn() % (MAX_CONGESTION + 1);
+                else edge.blocked = !edge.blocked;
+            }
+            rerouteGraph.refreshSubscriptions();
+            RouteSubscription fresh(-1, live.dest, testCar);
+            rerouteGraph.growTree(fresh);
+            treesAgree = treesAgree && fresh.dist == live.dist;
+        }
+        rerouteGraph.trips.cancelAll();
+        if (!rerouted || !treesAgree) fail() << "Test 16 failed: trip was not re-routed or tree repair diverged.\n" << RESET;
+
+        // Test 18: Monte Carlo percentiles depend on the seed only, not on the thread count
+        Graph scenarioGraph;
+        scenarioGraph.addDefaultRoads();
+        DemandMatrix noDemand; // Sample demand
+        auto single = scenarioGraph.runScenarios(noDemand, testCar, 300, 7, 1);
+        auto parallel = scenarioGraph.runScenarios(noDemand, testCar, 300, 7, 3);
+        auto reseeded = scenarioGraph.runScenarios(noDemand, testCar, 300, 8, 3);
+        bool reproducible = !single.empty() && single.size() == parallel.size(), seedMatters = false;
+        for (size_t i = 0; reproducible && i < single.size(); ++i) {
+            const MonteCarloRunner::Distribution &x = single[i], &y = parallel[i];
+            reproducible = x.p10 == y.p10 && x.p50 == y.p50 && x.p90 == y.p90 && x.p99 == y.p99 && x.worst == y.worst
+                && x.mean == y.mean && x.unreachable == y.unreachable && x.p10 <= x.p50 && x.p50 <= x.p90 && x.p90 <= x.p99;
+            seedMatters = seedMatters || x.mean != reseeded[i].mean;
+            // The Bus Terminal hangs off a bus lane: a static impossibility for cars, not a scenario result
+            reproducible = reproducible && x.neverReachable == (x.origin == "Bus Terminal") && (x.neverReachable ? x.runs == 0 : x.runs == 300);
+        }
+        if (!reproducible || !seedMatters) fail() << "Test 18 failed: Monte Carlo results changed with the thread count or ignored the seed.\n" << RESET;
+
+        // Test 19: Isochrones and PHAST sweeps agree with full Dijkstra trees
+        Graph isoGraph;
+        isoGraph.addGridCity(15, 19);
+        isoGraph.setRoadBlocked("G3_3", "G3_4", true);
+        isoGraph.edgeById(40).congestion = MAX_CONGESTION;
+        shared_ptr<RoutingSnapshot> isoNet = isoGraph.makeSnapshot();
+        bool isochronesAgree = true;
+        const int budget = 900;
+        for (int k = 0; k < 2; ++k) {
+            Vehicle vehicle = k ? Vehicle(AMBULANCE, true) : testCar;
+            ContractionHierarchy hierarchy(*isoNet, vehicle);
+            vector<int> sources, swept, best(isoNet->nodes->names.size(), ROUTE_UNREACHABLE);
+            for (int src = 0; src < static_cast<int>(isoNet->nodes->names.size()); src += 23) {
+                sources.push_back(src);
+                hierarchy.sweep(src, swept);
+                Isochrone iso = computeIsochrone(*isoNet, src, budget, vehicle);
+                isoNet->search(src, -1, vehicle, ws);
+                size_t inside = 0;
+                for (size_t v = 0; v < swept.size(); ++v) {
+                    int tree = ws.distance(static_cast<int>(v));
+                    isochronesAgree = isochronesAgree && swept[v] == (tree == numeric_limits<int>::max() ? ROUTE_UNREACHABLE : tree);
+                    if (swept[v] <= budget) ++inside;
+                    if (swept[v] <= budget) best[v] = min(best[v], swept[v]);
                 }
-                case 4: { // Apply Rush Hour Conditions
-                    cout << YELLOW << "\nApplying rush hour conditions...\n" << RESET;
-                    for (auto& nodePair : adjList) {
-                        for (auto& edge : nodePair.second) {
-                            // Retrieve the original base weight from baseEdges
-                            double originalWeight = 0;
-                            // Memory Safety: Check if key exists before using .at()
-                            if (baseEdges.count({nodePair.first, edge.destination})) {
-                                originalWeight = baseEdges.at({nodePair.first, edge.destination}).weight;
-                            } else if (baseEdges.count({edge.destination, nodePair.first})) {
-                                originalWeight = baseEdges.at({edge.destination, nodePair.first}).weight;
-                            }
-                            if (originalWeight == 0) originalWeight = edge.weight; // Fallback
+                isochronesAgree = isochronesAgree && iso.nodes.size() == inside && !iso.partialRoads.empty();
+                for (const auto& node : iso.nodes) isochronesAgree = isochronesAgree && node.second == ws.distance(node.first);
+            }
+            ContractionHierarchy::Coverage single = hierarchy.coverage(sources, budget, 1), parallel = hierarchy.coverage(sources, budget, 3);
+            isochronesAgree = isochronesAgree && single.time == best && single.nearest == parallel.nearest && single.time == parallel.time;
+        }
+        if (!isochronesAgree) fail() << "Test 19 failed: isochrones or PHAST sweeps disagree with Dijkstra.\n" << RESET;
+
+        // Test 20: Every batch kernel matches Dijkstra, also for a partial group of sources
+        bool batchesAgree = true;
+        vector<string> batchNames;
+        for (int src = 0; src < static_cast<int>(isoNet->nodes->names.size()); src += 17) batchNames.push_back(isoNet->nodes->names[src]); // 14 sources
+        for (int round = 0; round < 2; ++round) {
+            if (round) isoGraph.setRoadBlocked("G7_7", "G7_8", true); // The cached hierarchy must notice
+            shared_ptr<RoutingSnapshot> net = isoGraph.makeSnapshot();
+            size_t n = net->nodes->names.size();
+            vector<ContractionHierarchy::BatchKernel> kernels = {ContractionHierarchy::BATCH_SCALAR};
+#ifdef X86_SIMD
+            if (__builtin_cpu_supports("sse4.1")) kernels.push_back(ContractionHierarchy::BATCH_SSE41);
+            if (__builtin_cpu_supports("avx2")) kernels.push_back(ContractionHierarchy::BATCH_AVX2);
+#endif
+            for (ContractionHierarchy::BatchKernel kernel : kernels) {
+                vector<int> dist;
+                batchesAgree = batchesAgree && isoGraph.batchShortestPaths(batchNames, testCar, dist, kernel) && dist.size() == batchNames.size() * n;
+                for (size_t i = 0; batchesAgree && i < batchNames.size(); ++i) {
+                    net->search(net->nodes->ids.at(batchNames[i]), -1, testCar, ws);
+                    for (size_t v = 0; v < n; ++v) {
+                        int tree = ws.distance(static_cast<int>(v));
+                        batchesAgree = batchesAgree && dist[i * n + v] == (tree == numeric_limits<int>::max() ? ROUTE_UNREACHABLE : tree);
+                    }
+                }
+            }
+        }
+        vector<int> unused;
+        batchesAgree = batchesAgree && !isoGraph.batchShortestPaths({"G0_0", "Nowhere"}, testCar, unused);
+        if (!batchesAgree) fail() << "Test 20 failed: batch shortest paths disagree with Dijkstra.\n" << RESET;
+
+        // Test 21: Pareto routes match the front of every simple path; weighted routes lie on it
+        Graph paretoGraph;
+        paretoGraph.addGridCity(4, 5); // Highways on row 0 and column 0 carry tolls
+        paretoGraph.addRoad("G1_1", "G2_2", 40, 0, "Tunnel", false);
+        vector<RouteCosts> arcCosts;
+        vector<char> arcUsable;
+        paretoGraph.prepareCriteria(testCar, arcCosts, arcUsable);
+        vector<RouteCosts> front; // Brute force: costs of every simple path, then the non-dominated ones
+        vector<char> onPath(paretoGraph.nodeNames.size(), 0);
+        int paretoTarget = paretoGraph.nodeIds.at("G3_3");
+        function<void(int, RouteCosts)> walk = [&](int u, RouteCosts costs) {
+            if (u == paretoTarget) { front.push_back(costs); return; }
+            onPath[u] = 1;
+            for (const Edge& edge : *paretoGraph.nodeEdges[u]) {
+                if (!arcUsable[edge.id] || onPath[edge.to]) continue;
+                const RouteCosts& arc = arcCosts[edge.id];
+                walk(edge.to, {costs.time + arc.time, costs.toll + arc.toll, costs.co2 + arc.co2});
+            }
+            onPath[u] = 0;
+        };
+        walk(paretoGraph.nodeIds.at("G0_0"), RouteCosts());
+        auto dominatedIn = [](const vector<RouteCosts>& all, const RouteCosts& c) {
+            for (const RouteCosts& o : all) {
+                if (o.time <= c.time && o.toll <= c.toll && o.co2 <= c.co2 && (o.time < c.time || o.toll < c.toll || o.co2 < c.co2)) return true;
+            }
+            return false;
+        };
+        set<tuple<int, int, int>> expected, actual;
+        for (const RouteCosts& c : front) if (!dominatedIn(front, c)) expected.emplace(c.time, c.toll, c.co2);
+        ParetoResult pareto;
+        bool paretoAgrees = paretoGraph.computeParetoRoutes("G0_0", "G3_3", testCar, pareto) && pareto.complete && expected.size() > 1;
+        for (const ParetoRoute& r : pareto.routes) {
+            RouteCosts walked;
+            for (int e : r.edgeIds) {
+                walked.time += arcCosts[e].time; walked.toll += arcCosts[e].toll; walked.co2 += arcCosts[e].co2;
+            }
+            paretoAgrees = paretoAgrees && walked.time == r.costs.time && walked.toll == r.costs.toll && walked.co2 == r.costs.co2
+                && r.nodes.front() == paretoGraph.nodeIds.at("G0_0") && r.nodes.back() == paretoTarget && r.nodes.size() == r.edgeIds.size() + 1;
+            actual.emplace(r.costs.time, r.costs.toll, r.costs.co2);
+        }
+        paretoAgrees = paretoAgrees && actual == expected && actual.size() == pareto.routes.size();
+        Route fastest;
+        paretoAgrees = paretoAgrees && paretoGraph.computeRoute("G0_0", "G3_3", testCar, fastest) && pareto.routes[0].costs.time == fastest.totalTime;
+        for (double perDollar : {0.5, 20.0, 1000.0}) {
+            ParetoRoute weighted;
+            paretoAgrees = paretoAgrees && paretoGraph.computeWeightedRoute("G0_0", "G3_3", testCar, perDollar, 1.0, weighted)
+                && actual.count(make_tuple(weighted.costs.time, weighted.costs.toll, weighted.costs.co2));
+        }
+        ParetoResult unreachable;
+        paretoAgrees = paretoAgrees && !paretoGraph.computeParetoRoutes("G0_0", "Nowhere", testCar, unreachable);
+        if (!paretoAgrees) fail() << "Test 21 failed: Pareto routes differ from the brute-force front.\n" << RESET;
+
+        // Test 22: Telemetry streams decode back to the rows that were recorded, in every format
+        auto writeFrames = [](TelemetryExporter& exporter) {
+            for (uint32_t tick = 1; tick <= 2; ++tick) {
+                TelemetryFrame& frame = exporter.frame();
+                if (tick == 1) {
+                    frame.staticId = {0, 1};
+                    frame.staticSource = {exporter.code("North"), exporter.code("South")};
+                    frame.staticDestination = {exporter.code("South"), exporter.code("North")};
+                    frame.staticRoadType = {exporter.code("Highway"), exporter.code("Highway")};
+                    frame.staticBaseWeight = {120.5f, 120.5f};
+                    frame.staticSignalDelay = {30, 30};
+                }
+                frame.weight = {100.25f * tick, 90.0f};
+                frame.flow = {0.0f, 400.5f * tick};
+                frame.congestion = {static_cast<uint8_t>(tick), static_cast<uint8_t>(tick)};
+                frame.blocked = {0, static_cast<uint8_t>(tick == 2)};
+                exporter.recordTrip("North", "South", BUS, 300 + tick);
+                if (tick == 2) exporter.recordIncident("South", "Accident", 3, "Highway");
+                exporter.submit(tick, 2);
+            }
+        };
+        const string expectedRows[3] = {
+            "1,North,South,Highway,100.25,1,FALSE,0\n1,South,North,Highway,90,1,FALSE,400.5\n"
+            "2,North,South,Highway,200.5,2,FALSE,0\n2,South,North,Highway,90,2,TRUE,801\n",
+            "1,North,South,2,301\n2,North,South,2,302\n",
+            "2,South,Accident,3,Highway\n"};
+        bool telemetryRoundTrips = true;
+        const string columnarPath = "telemetry_test.tscol", csvBase = "telemetry_test";
+        for (bool compressed : {true, false}) {
+            remove(columnarPath.c_str());
+            {
+                TelemetryExporter exporter;
+                telemetryRoundTrips = telemetryRoundTrips && exporter.start(TELEMETRY_COLUMNAR, columnarPath, compressed);
+                writeFrames(exporter);
+            }
+            vector<TelemetryExporter::Block> blocks;
+            vector<string> dictionary;
+            telemetryRoundTrips = telemetryRoundTrips && TelemetryExporter::readColumnar(columnarPath, blocks, dictionary);
+            remove(columnarPath.c_str());
+            string rows[3];
+            vector<uint32_t> edgeCodes; // Source, destination and road type code per edge id
+            auto name = [&](uint32_t code) { return code < dictionary.size() ? dictionary[code] : string("?"); };
+            auto real = [](uint32_t bits) { float v; memcpy(&v, &bits, sizeof v); return v; };
+            for (const TelemetryExporter::Block& block : blocks) {
+                string tick = to_string(block.tick) + ",";
+                for (uint32_t r = 0; r < block.rows; ++r) {
+                    const vector<vector<uint32_t>>& c = block.columns;
+                    if (block.kind == 'S') {
+                        edgeCodes.insert(edgeCodes.end(), {c[1][r], c[2][r], c[3][r]});
+                    } else if (block.kind == 'E') {
+                        rows[0] += tick + name(edgeCodes[3 * r]) + "," + name(edgeCodes[3 * r + 1]) + "," + name(edgeCodes[3 * r + 2]) + ",";
+                        appendNumber(rows[0], real(c[0][r]));
+                        rows[0] += "," + to_string(c[1][r]) + (c[2][r] ? ",TRUE," : ",FALSE,");
+                        appendNumber(rows[0], real(c[3][r]));
+                        rows[0] += "\n";
+                    } else if (block.kind == 'T') {
+                        rows[1] += tick + name(c[0][r]) + "," + name(c[1][r]) + "," + to_string(c[2][r]) + "," + to_string(c[3][r]) + "\n";
+                    } else if (block.kind == 'I') {
+                        rows[2] += tick + name(c[0][r]) + "," + name(c[1][r]) + "," + to_string(c[2][r]) + "," + name(c[3][r]) + "\n";
+                    }
+                }
+            }
+            for (int i = 0; i < 3; ++i) telemetryRoundTrips = telemetryRoundTrips && rows[i] == expectedRows[i];
+        }
+        const char* csvSuffixes[3] = {"_edges.csv", "_trips.csv", "_incidents.csv"};
+        for (const char* suffix : csvSuffixes) remove((csvBase + suffix).c_str());
+        {
+            TelemetryExporter exporter;
+            telemetryRoundTrips = telemetryRoundTrips && exporter.start(TELEMETRY_CSV, csvBase, true);
+            writeFrames(exporter);
+        }
+        for (int i = 0; i < 3; ++i) {
+            ifstream csv(csvBase + csvSuffixes[i]);
+            string header, body((istreambuf_iterator<char>(getline(csv, header))), istreambuf_iterator<char>());
+            telemetryRoundTrips = telemetryRoundTrips && !header.empty() && body == expectedRows[i];
+            remove((csvBase + csvSuffixes[i]).c_str());
+        }
+        if (!telemetryRoundTrips) fail() << "Test 22 failed: telemetry rows did not survive the round trip.\n" << RESET;
+        return failures;
+    }
+    #endif
+
+    // Benchmark Scaffolding
+    #ifdef BENCHMARK
+    public:
+    // Runs every query with one queue type; returns milliseconds and a checksum of distances.
+    template <class Queue>
+    static pair<double, long long> timeQueue(Graph& g, const vector<pair<int, int>>& queries, const Vehicle& vehicle) {
+        QueryWorkspace& ws = queryWorkspace();
+        Queue& queue = pooledQueue<Queue>();
+        g.searchRoute(queries[0].first, queries[0].second, vehicle, ws, queue); // Warm-up
+        long long checksum = 0;
+        auto start = chrono::high_resolution_clock::now();
+        for (const auto& q : queries) checksum += g.searchRoute(q.first, q.second, vehicle, ws, queue);
+        auto end = chrono::high_resolution_clock::now();
+        return {chrono::duration<double, milli>(end - start).count(), checksum};
+    }
+
+    static void runBenchmarks() {
+        cout << CYAN << "\n=== Routing Priority Queue Benchmark ===\n" << RESET;
+        cout << "Grid city, random point-to-point car queries (ms per query)\n";
+        cout << left << setw(10) << "Nodes" << setw(10) << "Queries" << setw(14) << "BinaryHeap"
+             << setw(14) << "4-aryHeap" << setw(14) << "Dial" << setw(14) << "RadixHeap" << "Winner\n" << right;
+        Vehicle car(CAR);
+        for (int side : {32, 100, 316}) {
+            Graph g;
+            g.addGridCity(side, 42);
+            g.applyWeatherEffects();
+            int n = static_cast<int>(g.nodeNames.size());
+            int count = side < 100 ? 2000 : (side < 300 ? 300 : 40);
+            mt19937 rng(1234);
+            vector<pair<int, int>> queries;
+            for (int i = 0; i < count; ++i) queries.push_back({static_cast<int>(rng() % n), static_cast<int>(rng() % n)});
+
+            pair<double, long long> results[4] = {
+                timeQueue<BinaryHeapQueue>(g, queries, car),
+                timeQueue<IndexedDaryHeap<4>>(g, queries, car),
+                timeQueue<DialQueue>(g, queries, car),
+                timeQueue<RadixHeapQueue>(g, queries, car)};
+            const char* names[4] = {"BinaryHeap", "4-aryHeap", "Dial", "RadixHeap"};
+            int winner = 0;
+            cout << left << setw(10) << n << setw(10) << count;
+            for (int i = 0; i < 4; ++i) {
+                if (results[i].second != results[0].second) cout << RED << "checksum mismatch! " << RESET;
+                if (results[i].first < results[winner].first) winner = i;
+                cout << setw(14) << fixed << setprecision(4) << results[i].first / count;
+            }
+            cout << names[winner] << "\n" << right;
+        }
+
+        cout << CYAN << "\n=== Vehicle Policy Kernels ===\n" << RESET;
+        cout << "Same queries, Dial queue: compile-time policy vs runtime policy (ms per query)\n";
+        cout << left << setw(10) << "Nodes" << setw(14) << "Static" << setw(14) << "Runtime" << "Speedup\n" << right;
+        for (int side : {100, 316}) {
+            Graph g;
+            g.addGridCity(side, 42);
+            g.applyWeatherEffects();
+            int n = static_cast<int>(g.nodeNames.size());
+            int count = side < 300 ? 300 : 40;
+            mt19937 rng(1234);
+            vector<pair<int, int>> queries;
+            for (int i = 0; i < count; ++i) queries.push_back({static_cast<int>(rng() % n), static_cast<int>(rng() % n)});
+
+            QueryWorkspace& ws = queryWorkspace();
+            DialQueue& queue = pooledQueue<DialQueue>();
+            RuntimeVehiclePolicy runtime(car);
+            g.searchKernel(queries[0].first, queries[0].second, runtime, ws, queue); // Warm-up
+            long long staticSum = 0, runtimeSum = 0;
+            auto t0 = chrono::high_resolution_clock::now();
+            for (const auto& q : queries) staticSum += g.searchKernel(q.first, q.second, VehiclePolicy<CAR, false>(), ws, queue);
+            auto t1 = chrono::high_resolution_clock::now();
+            for (const auto& q : queries) runtimeSum += g.searchKernel(q.first, q.second, runtime, ws, queue);
+            auto t2 = chrono::high_resolution_clock::now();
+            double staticMs = chrono::duration<double, milli>(t1 - t0).count(), runtimeMs = chrono::duration<double, milli>(t2 - t1).count();
+            if (staticSum != runtimeSum) cout << RED << "checksum mismatch! " << RESET;
+            cout << left << setw(10) << n << setw(14) << fixed << setprecision(4) << staticMs / count
+                 << setw(14) << runtimeMs / count << setprecision(2) << runtimeMs / staticMs << "x\n" << right;
+        }
+
+        cout << CYAN << "\n=== Whole-City Coverage ===\n" << RESET;
+        cout << "One-to-all car trees from many sources: Dijkstra vs PHAST on a contraction hierarchy (ms per source)\n";
+        cout << left << setw(10) << "Nodes" << setw(10) << "Sources" << setw(14) << "Prepare ms" << setw(14) << "Dijkstra"
+             << setw(14) << "PHAST" << "Speedup\n" << right;
+        for (int side : {32, 100}) {
+            Graph g;
+            g.addGridCity(side, 42);
+            shared_ptr<RoutingSnapshot> net = g.makeSnapshot();
+            int n = static_cast<int>(net->nodes->names.size());
+            int count = 64;
+            QueryWorkspace& ws = queryWorkspace();
+            auto t0 = chrono::high_resolution_clock::now();
+            ContractionHierarchy hierarchy(*net, car);
+            auto t1 = chrono::high_resolution_clock::now();
+            long long dijkstraSum = 0, phastSum = 0;
+            for (int i = 0; i < count; ++i) {
+                net->search(i * n / count, -1, car, ws);
+                for (int v = 0; v < n; ++v) dijkstraSum += ws.distance(v);
+            }
+            auto t2 = chrono::high_resolution_clock::now();
+            vector<int> dist;
+            for (int i = 0; i < count; ++i) {
+                hierarchy.sweep(i * n / count, dist);
+                for (int v = 0; v < n; ++v) phastSum += dist[v];
+            }
+            auto t3 = chrono::high_resolution_clock::now();
+            double prepareMs = chrono::duration<double, milli>(t1 - t0).count();
+            double dijkstraMs = chrono::duration<double, milli>(t2 - t1).count(), phastMs = chrono::duration<double, milli>(t3 - t2).count();
+            if (dijkstraSum != phastSum) cout << RED << "checksum mismatch! " << RESET;
+            cout << left << setw(10) << n << setw(10) << count << setw(14) << fixed << setprecision(1) << prepareMs
+                 << setw(14) << setprecision(4) << dijkstraMs / count << setw(14) << phastMs / count
+                 << setprecision(2) << dijkstraMs / phastMs << "x\n" << right;
+        }
+
+        cout << CYAN << "\n=== Batch Shortest Paths ===\n" << RESET;
+        cout << "64 car sources to every node on 10000 nodes: the shortestPath kernel per source vs batch sweeps (ms per source);\n"
+             << "the scalar sweep's gain is the hierarchy, the vs scalar column is what the SIMD lanes add on top\n";
+        {
+            Graph g;
+            g.addGridCity(100, 42);
+            int n = static_cast<int>(g.nodeNames.size()), count = 64;
+            vector<string> sources;
+            for (int i = 0; i < count; ++i) sources.push_back(g.nodeNames[i * n / count]);
+            QueryWorkspace& ws = queryWorkspace();
+            DefaultRouteQueue& queue = pooledQueue<DefaultRouteQueue>();
+            long long baseSum = 0;
+            auto t0 = chrono::high_resolution_clock::now();
+            for (const string& name : sources) {
+                g.searchRoute(g.nodeIds.at(name), -1, car, ws, queue);
+                for (int v = 0; v < n; ++v) baseSum += ws.distance(v) == numeric_limits<int>::max() ? ROUTE_UNREACHABLE : ws.distance(v);
+            }
+            double baseMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t0).count();
+            vector<int> dist;
+            auto t1 = chrono::high_resolution_clock::now();
+            g.batchShortestPaths(sources, car, dist, ContractionHierarchy::BATCH_SCALAR); // Builds the hierarchy once
+            cout << "Hierarchy preparation and first batch: " << fixed << setprecision(1)
+                 << chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count() << " ms\n";
+            cout << left << setw(14) << "Kernel" << setw(14) << "ms/source" << setw(10) << "Speedup" << "vs scalar\n" << right;
+            cout << left << setw(14) << "shortestPath" << setw(14) << setprecision(4) << baseMs / count << setw(10) << "1.00x" << "-\n" << right;
+            vector<ContractionHierarchy::BatchKernel> kernels = {ContractionHierarchy::BATCH_SCALAR};
+#ifdef X86_SIMD
+            if (__builtin_cpu_supports("sse4.1")) kernels.push_back(ContractionHierarchy::BATCH_SSE41);
+            if (__builtin_cpu_supports("avx2")) kernels.push_back(ContractionHierarchy::BATCH_AVX2);
+#endif
+            double scalarMs = 0;
+            for (ContractionHierarchy::BatchKernel kernel : kernels) {
+                auto t2 = chrono::high_resolution_clock::now();
+                g.batchShortestPaths(sources, car, dist, kernel);
+                double batchMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t2).count();
+                long long batchSum = 0;
+                for (int time : dist) batchSum += time;
+                if (kernel == ContractionHierarchy::BATCH_SCALAR) scalarMs = batchMs; // Scalar runs first
+                if (batchSum != baseSum) cout << RED << "checksum mismatch! " << RESET;
+                ostringstream speedup;
+                speedup << fixed << setprecision(2) << baseMs / batchMs << "x";
+                cout << left << setw(14) << ContractionHierarchy::kernelName(kernel) << setw(14) << setprecision(4) << batchMs / count
+                     << setw(10) << speedup.str() << setprecision(2) << scalarMs / batchMs << "x\n" << right;
+            }
+        }
+
+        cout << CYAN << "\n=== Trade-off Routes ===\n" << RESET;
+        cout << "Car Pareto sets over time, toll and CO2 between opposite corners vs the weighted-sum fast path\n";
+        cout << left << setw(10) << "Nodes" << setw(10) << "Routes" << setw(12) << "Labels" << setw(12) << "Complete"
+             << setw(14) << "Pareto ms" << "Weighted ms\n" << right;
+        for (int side : {20, 40, 70}) {
+            Graph g;
+            g.addGridCity(side, 42);
+            string src = "G0_" + to_string(side - 1), dest = "G" + to_string(side - 1) + "_0";
+            ParetoResult result;
+            ParetoRoute weighted;
+            g.computeWeightedRoute(src, dest, car, 60, 30, weighted); // Warm-up: weather and closures applied
+            auto t0 = chrono::high_resolution_clock::now();
+            g.computeParetoRoutes(src, dest, car, result);
+            auto t1 = chrono::high_resolution_clock::now();
+            g.computeWeightedRoute(src, dest, car, 60, 30, weighted);
+            auto t2 = chrono::high_resolution_clock::now();
+            cout << left << setw(10) << side * side << setw(10) << result.routes.size() << setw(12) << result.labels
+                 << setw(12) << (result.complete ? "yes" : "no") << setw(14) << fixed << setprecision(1)
+                 << chrono::duration<double, milli>(t1 - t0).count() << setprecision(2)
+                 << chrono::duration<double, milli>(t2 - t1).count() << "\n" << right;
+        }
+    }
+    #endif
+};
+
+// ================ ROUTING QUERY SERVER ================
+// Serves routing queries to dispatch tools over a localhost TCP port ("127.0.0.1:7878" or just
+// "7878") or a Unix socket ("unix:/path"). One request per line, fields separated by '|'; each
+// request gets exactly one response line, "OK|..." or "ERR|<reason>", in request order:
+//   PING                                      -> OK|PONG
+//   NODES                                     -> OK|<node>|<node>|...
+//   ROUTE|<vehicle>|<from>|<to>               -> OK|<seconds>|<node>|<node>|...
+//   MATRIX|<vehicle>|<a;b;...>|<x;y;...>      -> OK|<a->x>,<a->y>,...;<b->x>,...   (-1 = unreachable)
+//   INCIDENT|<location>|<road type>|<severity 1-3>[|<description>]
+//   CLOSURE|<from>|<to>       REOPEN|<from>|<to>
+//   WEATHER|<SUNNY|RAIN|SNOW|FOG|STORM>       -> OK|<snapshot version>
+// <vehicle> is car, bike, bus, ambulance, police or fire; a trailing '!' turns on emergency mode.
+// The epoll event loop owns the Graph and applies updates itself; ROUTE and MATRIX run on a
+// worker pool against the latest immutable RoutingSnapshot, republished after every update.
+#ifndef _WIN32
+// Lifts the soft open-file limit to the hard limit so thousands of sockets can be open at once.
+void raiseFileLimit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Listening (listenMode) or connected stream socket for a server address; -1 on failure.
+// TCP addresses are always bound to the loopback interface.
+int openServerSocket(const string& address, bool listenMode) {
+    int sock = -1;
+    if (address.compare(0, 5, "unix:") == 0) {
+        string path = address.substr(5);
+        sockaddr_un local{};
+        if (path.empty() || path.size() >= sizeof(local.sun_path)) return -1;
+        local.sun_family = AF_UNIX;
+        strncpy(local.sun_path, path.c_str(), sizeof(local.sun_path) - 1);
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock < 0) return -1;
+        if (listenMode) unlink(path.c_str()); // Replace a stale socket file from an earlier run
+        int result = listenMode ? ::bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local))
+                                : connect(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+        if (result < 0) { close(sock); return -1; }
+    } else {
+        size_t colon = address.rfind(':');
+        string host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+        if (host == "localhost") host = "127.0.0.1";
+        int port = 0;
+        try { port = stoi(colon == string::npos ? address : address.substr(colon + 1)); } catch (...) { return -1; }
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(static_cast<uint16_t>(port));
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &local.sin_addr) != 1) return -1;
+        if (listenMode && ntohl(local.sin_addr.s_addr) >> 24 != 127) return -1; // Localhost only
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0) return -1;
+        int on = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Small request/response lines
+        if (listenMode) setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        int result = listenMode ? ::bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local))
+                                : connect(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+        if (result < 0) { close(sock); return -1; }
+    }
+    if (listenMode && listen(sock, SOMAXCONN) < 0) { close(sock); return -1; }
+    return sock;
+}
+#endif
+
+#ifdef __linux__
+volatile sig_atomic_t serverInterrupted = 0; // Set by SIGINT/SIGTERM in server mode
+
+class QueryServer {
+public:
+    explicit QueryServer(Graph& g) : graph(g) {
+        // Stock vehicles are built here, on the owning thread, because Vehicle's constructor
+        // registers road type names; workers only look them up.
+        for (int type = CAR; type <= FIRE_TRUCK; ++type) {
+            vehicles.push_back(Vehicle(static_cast<VehicleType>(type), false));
+            vehicles.push_back(Vehicle(static_cast<VehicleType>(type), true));
+        }
+    }
+
+    ~QueryServer() {
+        for (auto& entry : connections) close(entry.second.fd);
+        if (listenFd >= 0) close(listenFd);
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+    }
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    bool open(const string& address) {
+        listenFd = openServerSocket(address, true);
+        if (listenFd < 0) return false;
+        if (address.compare(0, 5, "unix:") == 0) unixPath = address.substr(5);
+        fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) return false;
+        watch(listenFd, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeFd, WAKE_ID, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
+    }
+
+    // Runs the event loop on the calling thread until stop() or SIGINT/SIGTERM.
+    void run(unsigned workerCount) {
+        publishSnapshot();
+        stopping = false;
+        for (unsigned w = 0; w < max(1u, workerCount); ++w) workers.emplace_back(&QueryServer::workerLoop, this);
+
+        epoll_event events[256];
+        auto lastRefresh = chrono::steady_clock::now();
+        while (!stopRequested && !serverInterrupted) {
+            int ready = epoll_wait(epollFd, events, 256, 1000);
+            if (ready < 0 && errno != EINTR) break;
+            for (int i = 0; i < ready; ++i) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID) acceptConnections();
+                else if (id == WAKE_ID) deliverReplies();
+                else serviceConnection(id, events[i].events);
+            }
+            // Weather changes and new or expired incidents outside the protocol (e.g. the weather
+            // thread) republish the snapshot within a second.
+            auto now = chrono::steady_clock::now();
+            if (now - lastRefresh >= chrono::seconds(1)) {
+                lastRefresh = now;
+                if (currentWeather != snapshot->weather || IncidentMonitor::getInstance().version() != snapshot->incidentVersion) publishSnapshot();
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& worker : workers) worker.join();
+        workers.clear();
+    }
+
+    // Thread-safe: asks run() to return.
+    void stop() {
+        stopRequested = true;
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {} // Wakes epoll_wait; failure means it is already pending
+    }
+
+    void showStatus() const {
+        cout << CYAN << "\n=== QUERY SERVER STATISTICS ===\n" << RESET
+             << "Connections accepted: " << accepted << " | open: " << connections.size() << "\n"
+             << "Requests served: " << served << " (route " << routeRequests << ", matrix " << matrixRequests
+             << ", update " << updateRequests << ") | errors: " << errorReplies << "\n"
+             << "Snapshots published: " << snapshotVersion << "\n";
+    }
+
+private:
+    static const uint64_t LISTEN_ID = 0, WAKE_ID = 1;
+    static const size_t MAX_REQUEST_BYTES = 1 << 16;
+    static const size_t MAX_MATRIX_CELLS = 1 << 20;
+
+    struct Connection {
+        int fd;
+        string in, out;          // Unparsed input, unsent output
+        deque<string> pending;   // Complete request lines not yet started
+        bool busy = false;       // A request is on the worker pool; later ones wait to keep order
+        bool wantWrite = false;  // EPOLLOUT armed because the socket buffer filled up
+        bool readClosed = false; // Peer shut down its side; close once everything is answered
+    };
+
+    struct Job {
+        uint64_t connection;
+        string request;
+    };
+
+    Graph& graph;
+    vector<Vehicle> vehicles;  // Index 2 * type + emergency
+    int listenFd = -1, epollFd = -1, wakeFd = -1;
+    string unixPath;
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnectionId = 2;
+    atomic<bool> stopRequested{false};
+
+    shared_ptr<const RoutingSnapshot> snapshot; // Read with atomic_load by the workers
+    uint64_t snapshotVersion = 0;
+
+    vector<thread> workers;
+    mutex jobMutex;
+    condition_variable jobReady;
+    deque<Job> jobs;
+    bool stopping = false;
+    mutex replyMutex;
+    vector<pair<uint64_t, string>> replies; // Finished jobs waiting for the event loop
+
+    // Event-loop statistics
+    uint64_t accepted = 0, served = 0, routeRequests = 0, matrixRequests = 0, updateRequests = 0, errorReplies = 0;
+
+    void watch(int fd, uint64_t id, uint32_t events, int op) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(epollFd, op, fd, &event);
+    }
+
+    void publishSnapshot() {
+        shared_ptr<RoutingSnapshot> fresh = graph.makeSnapshot();
+        fresh->version = ++snapshotVersion;
+        atomic_store(&snapshot, shared_ptr<const RoutingSnapshot>(fresh));
+    }
+
+    void acceptConnections() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN: backlog drained (EMFILE and friends: retry on the next event)
+            uint64_t id = nextConnectionId++;
+            connections[id].fd = fd;
+            watch(fd, id, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+            ++accepted;
+        }
+    }
+
+    void closeConnection(uint64_t id) {
+        auto it = connections.find(id);
+        if (it == connections.end()) return;
+        close(it->second.fd); // Also removes it from the epoll set
+        connections.erase(it);
+    }
+
+    void serviceConnection(uint64_t id, uint32_t events) {
+        auto it = connections.find(id);
+        if (it == connections.end()) return; // Closed earlier in this batch
+        Connection& c = it->second;
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            char buffer[16384];
+            while (true) {
+                ssize_t got = recv(c.fd, buffer, sizeof(buffer), 0);
+                if (got > 0) { c.in.append(buffer, got); continue; }
+                if (got == 0) c.readClosed = true;
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { closeConnection(id); return; }
+                break;
+            }
+            size_t start = 0, newline;
+            while ((newline = c.in.find('\n', start)) != string::npos) {
+                size_t end = (newline > start && c.in[newline - 1] == '\r') ? newline - 1 : newline;
+                if (end > start) c.pending.push_back(c.in.substr(start, end - start));
+                start = newline + 1;
+            }
+            c.in.erase(0, start);
+            if (c.in.size() > MAX_REQUEST_BYTES) { closeConnection(id); return; } // No newline in sight
+        }
+        pump(id, c);
+    }
+
+    // Starts queued requests in order, answering cheap ones inline, then flushes replies.
+    void pump(uint64_t id, Connection& c) {
+        while (!c.busy && !c.pending.empty()) {
+            string request = move(c.pending.front());
+            c.pending.pop_front();
+            string op = request.substr(0, request.find('|'));
+            if (op == "ROUTE" || op == "MATRIX") {
+                ++(op == "ROUTE" ? routeRequests : matrixRequests);
+                c.busy = true;
+                {
+                    lock_guard<mutex> lock(jobMutex);
+                    jobs.push_back({id, move(request)});
+                }
+                jobReady.notify_one();
+            } else {
+                reply(c, handleInline(op, request));
+            }
+        }
+        if (!flush(id, c) || (c.readClosed && !c.busy && c.pending.empty() && c.out.empty())) closeConnection(id);
+    }
+
+    void reply(Connection& c, const string& text) {
+        c.out += text;
+        c.out += '\n';
+        ++served;
+        if (text.compare(0, 3, "ERR") == 0) ++errorReplies;
+    }
+
+    // Writes as much buffered output as the socket takes; false if the connection broke.
+    bool flush(uint64_t id, Connection& c) {
+        size_t sent = 0;
+        while (sent < c.out.size()) {
+            ssize_t wrote = send(c.fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL);
+            if (wrote > 0) { sent += wrote; continue; }
+            if (wrote < 0 && errno == EINTR) continue;
+            if (wrote < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        c.out.erase(0, sent);
+        bool needWrite = !c.out.empty();
+        if (needWrite != c.wantWrite) {
+            c.wantWrite = needWrite;
+            watch(c.fd, id, EPOLLIN | EPOLLRDHUP | (needWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u), EPOLL_CTL_MOD);
+        }
+        return true;
+    }
+
+    void deliverReplies() {
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0) {}
+        vector<pair<uint64_t, string>> finished;
+        {
+            lock_guard<mutex> lock(replyMutex);
+            finished.swap(replies);
+        }
+        for (auto& done : finished) {
+            auto it = connections.find(done.first);
+            if (it == connections.end()) continue; // Client went away while its query ran
+            it->second.busy = false;
+            reply(it->second, done.second);
+            pump(done.first, it->second);
+        }
+    }
+
+    // PING, NODES and the updates, which must run on the thread that owns the graph.
+    string handleInline(const string& op, const string& request) {
+        if (op == "PING") return "OK|PONG";
+        if (op == "NODES") {
+            shared_ptr<const RoutingSnapshot> current = atomic_load(&snapshot);
+            string text = "OK";
+            for (const string& name : current->nodes->names) text += "|" + name;
+            return text;
+        }
+        if (op == "INCIDENT" || op == "CLOSURE" || op == "REOPEN" || op == "WEATHER") {
+            // Updates share the incident feed's grammar: "<time>,<KIND>,<fields...>"
+            string line = "0," + request;
+            replace(line.begin(), line.end(), '|', ',');
+            FeedEvent event;
+            if (!parseFeedLine(line, event)) return "ERR|malformed " + op;
+            if ((event.kind == FEED_CLOSURE || event.kind == FEED_REOPEN)
+                && !graph.setRoadBlocked(event.location, event.target, event.kind == FEED_CLOSURE)) {
+                return "ERR|no road between " + event.location + " and " + event.target;
+            }
+            if (event.kind != FEED_CLOSURE && event.kind != FEED_REOPEN) graph.applyFeedBatch(vector<FeedEvent>(1, event));
+            ++updateRequests;
+            publishSnapshot();
+            return "OK|" + to_string(snapshotVersion);
+        }
+        return "ERR|unknown request " + op;
+    }
+
+    const Vehicle* parseVehicle(const string& text) const {
+        VehicleType type;
+        bool emergency;
+        return parseVehicleName(text, type, emergency) ? &vehicles[2 * type + (emergency ? 1 : 0)] : nullptr;
+    }
+
+    void workerLoop() {
+        QueryWorkspace& ws = queryWorkspace();
+        unique_lock<mutex> lock(jobMutex);
+        while (true) {
+            jobReady.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            Job job = move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            shared_ptr<const RoutingSnapshot> current = atomic_load(&snapshot);
+            string answer = answerQuery(*current, job.request, ws);
+            {
+                lock_guard<mutex> replyLock(replyMutex);
+                replies.push_back({job.connection, move(answer)});
+            }
+            uint64_t one = 1;
+            if (write(wakeFd, &one, sizeof(one)) < 0) {} // Counter already non-zero: a wake-up is pending
+            lock.lock();
+        }
+    }
 
-                            edge.weight = originalWeight * 1.5; // Increase travel time by 50%
-                            edge.congestion = rand() % MAX_CONGESTION + 1; // Add 1-MAX_CONGESTION congestion units
-                        }
-                    }
-                    cout << GREEN << "Rush hour applied! Traffic is heavier and slower.\n" << RESET;
-                    break;
-                }
-                case 5: { // Calculate Shortest Path (with Strategy Pattern selection)
-                    cout << "Enter source node: "; getline(cin, src);
-                    cout << "Enter destination node: "; getline(cin, dest);
+    // ROUTE and MATRIX against one snapshot; runs on a worker thread.
+    string answerQuery(const RoutingSnapshot& net, const string& request, QueryWorkspace& ws) const {
+        vector<string> fields = splitFields(request, '|');
+        if (fields.size() != 4) return "ERR|expected " + fields[0] + "|<vehicle>|<from>|<to>";
+        const Vehicle* vehicle = parseVehicle(fields[1]);
+        if (!vehicle) return "ERR|unknown vehicle " + fields[1];
 
-                    cout << "Select routing strategy (1: " << YELLOW << "Fastest Route" << RESET << ", 2: " << RED << "Emergency Route" << RESET << "): ";
-                    string strategyChoiceStr;
-                    getline(cin, strategyChoiceStr);
-                    int strategyChoice = -1;
-                    try { strategyChoice = stoi(strategyChoiceStr); } catch(...) {}
+        if (fields[0] == "ROUTE") {
+            auto from = net.nodes->ids.find(fields[2]), to = net.nodes->ids.find(fields[3]);
+            if (from == net.nodes->ids.end()) return "ERR|unknown node " + fields[2];
+            if (to == net.nodes->ids.end()) return "ERR|unknown node " + fields[3];
+            if (from->second == to->second) return "OK|0|" + fields[2];
+            int time = net.search(from->second, to->second, *vehicle, ws);
+            if (time < 0) return "ERR|unreachable";
+            string text = "OK|" + to_string(time);
+            for (int v : ws.pathNodes) text += "|" + net.nodes->names[v];
+            return text;
+        }
 
-                    unique_ptr<RoutingStrategy> strategy; // Use smart pointer for strategy
-                    switch (strategyChoice) {
-                        case 1: strategy = make_unique<FastestRoute>(); break;
-                        case 2: strategy = make_unique<EmergencyRoute>(); break;
-                        default:
-                            cout << RED << "Invalid strategy. Defaulting to Fastest Route (Car).\n" << RESET;
-                            strategy = make_unique<FastestRoute>();
-                            break;
-                    }
-                    strategy->calculate(*this, src, dest); // Pass 'this' (the Graph object)
-                    break;
-                }
-                case 6: { // Compare Vehicle Routes (using Strategy Pattern)
-                    cout << "Enter source node for comparison: "; getline(cin, src);
-                    cout << "Enter destination node for comparison: "; getline(cin, dest);
-                    cout << YELLOW << "Comparing route for Car (Fastest) vs. Ambulance (Emergency):\n" << RESET;
+        vector<string> origins = splitFields(fields[2], ';'), destinations = splitFields(fields[3], ';');
+        if (origins.size() * destinations.size() > MAX_MATRIX_CELLS) return "ERR|matrix too large";
+        vector<int> destinationIds;
+        for (const string& name : destinations) {
+            auto it = net.nodes->ids.find(name);
+            if (it == net.nodes->ids.end()) return "ERR|unknown node " + name;
+            destinationIds.push_back(it->second);
+        }
+        string text = "OK|";
+        for (size_t i = 0; i < origins.size(); ++i) {
+            auto it = net.nodes->ids.find(origins[i]);
+            if (it == net.nodes->ids.end()) return "ERR|unknown node " + origins[i];
+            net.search(it->second, -1, *vehicle, ws); // One tree per origin serves the whole row
+            if (i > 0) text += ';';
+            for (size_t j = 0; j < destinationIds.size(); ++j) {
+                if (j > 0) text += ',';
+                text += to_string(ws.reached(destinationIds[j]) ? ws.distance(destinationIds[j]) : -1);
+            }
+        }
+        return text;
+    }
+};
 
-                    FastestRoute fastestStrategy;
-                    cout << BOLD << "\n--- Car Route ---\n" << RESET;
-                    fastestStrategy.calculate(*this, src, dest);
+// Closed-loop load generator: 'connections' clients each keep one ROUTE request in flight
+// against the server for 'seconds', then latency percentiles and throughput are reported.
+void runLoadGenerator(const string& address, int connections, double seconds) {
+    raiseFileLimit();
+    // Fetch the node names first so requests cover the server's actual map
+    int probe = openServerSocket(address, false);
+    if (probe < 0) {
+        cout << RED << "Error: Could not connect to " << address << ".\n" << RESET;
+        return;
+    }
+    string line;
+    char buffer[65536];
+    if (send(probe, "NODES\n", 6, MSG_NOSIGNAL) == 6) {
+        while (line.find('\n') == string::npos) {
+            ssize_t got = recv(probe, buffer, sizeof(buffer), 0);
+            if (got <= 0) break;
+            line.append(buffer, got);
+        }
+    }
+    close(probe);
+    vector<string> nodes = splitFields(line.substr(0, line.find('\n')), '|');
+    if (nodes.size() < 3 || nodes[0] != "OK") {
+        cout << RED << "Error: Server did not list its nodes.\n" << RESET;
+        return;
+    }
+    nodes.erase(nodes.begin());
 
-                    EmergencyRoute emergencyStrategy;
-                    cout << BOLD << "\n--- Ambulance Route (Emergency Mode) ---\n" << RESET;
-                    emergencyStrategy.calculate(*this, src, dest);
-                    break;
-                }
-                case 7: { // Waypoint Routing (Limited)
-                    cout << YELLOW << "\nWaypoint routing is currently a direct path calculation. For multi-stop journeys, run shortest path multiple times.\n" << RESET;
-                    cout << "Enter source node: "; getline(cin, src);
-                    cout << "Enter destination node: "; getline(cin, dest);
+    struct Client {
+        int fd;
+        string in;
+        chrono::steady_clock::time_point sentAt;
+        bool waiting = false;
+    };
+    vector<Client> clients;
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i < connections; ++i) {
+        int fd = openServerSocket(address, false);
+        if (fd < 0) break;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        Client client;
+        client.fd = fd;
+        clients.push_back(client);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = clients.size() - 1;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+    if (static_cast<int>(clients.size()) < connections) {
+        cout << YELLOW << "Only " << clients.size() << " of " << connections << " connections could be opened.\n" << RESET;
+    }
 
-                    Vehicle car(CAR); // Default to car for this
-                    shortestPath(src, dest, car);
-                    break;
-                }
-                case 8: { // Save/Load Data
-                    cout << RED << "Save/Load functionality not implemented yet!\n" << RESET;
-                    break;
-                }
-                case 9: { // AI Traffic Analysis
-                    cout << "Enter start node for AI analysis: "; getline(cin, src);
-                    // Input Validation: Start node cannot be empty
-                    if (src.empty()) {
-                        cout << RED << "Error: Start node name cannot be empty!\n" << RESET;
-                        break;
-                    }
-                    cout << "Enter end node for AI analysis: "; getline(cin, dest);
-                    // Input Validation: End node cannot be empty
-                    if (dest.empty()) {
-                        cout << RED << "Error: End node name cannot be empty!\n" << RESET;
-                        break;
-                    }
-                    if (src == dest) {
-                        cout << RED << "Error: Start and end nodes cannot be the same for AI analysis.\n" << RESET;
-                        break;
-                    }
-                    ai.analyze(src, dest);
-                    ai.predictCongestion(src, dest);
-                    break;
-                }
-                case 10: { // Emergency Mode
-                    cout << BLUE << "Activating emergency siren (this is a simulation effect).\n" << RESET;
-                    playSiren();
-                    break;
-                }
-                case 11: { // City Traffic Statistics
-                    cout << MAGENTA << "\n=== CITY TRAFFIC STATISTICS ===\n" << RESET;
-                    cout << "Current Weather: " << getWeatherMessage() << endl;
-                    IncidentMonitor::getInstance().showActiveIncidents(); // Singleton access
-                    cout << "Time Multiplier: " << timeMultiplier << "x\n";
-                    // Add more stats for a richer experience
-                    cout << "Total Nodes in Map: " << adjList.size() << endl;
-                    int totalEdges = 0;
-                    for(const auto& nodePair : adjList) {
-                        totalEdges += nodePair.second.size();
-                    }
-                    cout << "Total Road Segments: " << totalEdges << endl;
-                    break;
-                }
-                case 13: { // Time Controls
-                    cout << "\n⏳ TIME CONTROLS:\n"
-                         << GREEN << "1. " << WHITE << "Pause (0x Speed)\n"
-                         << GREEN << "2. " << WHITE << "2x Speed\n"
-                         << GREEN << "3. " << WHITE << "5x Speed\n"
-                         << YELLOW << "4. " << WHITE << "Rewind (Not Implemented Yet)\n" // Not yet implemented
-                         << BOLD << "Choice: " << RESET;
-                    string choiceStr;
-                    getline(cin, choiceStr);
-                    int choice = -1;
-                    try { choice = stoi(choiceStr); } catch(...) {} // Safe conversion
+    mt19937 rng(2024);
+    const char* vehicleNames[] = {"car", "car", "car", "bus", "bike", "ambulance!"};
+    vector<double> latencies;
+    uint64_t errors = 0, failedSends = 0;
+    auto sendRequest = [&](Client& client) {
+        string request = string("ROUTE|") + vehicleNames[rng() % 6] + "|" + nodes[rng() % nodes.size()] + "|" + nodes[rng() % nodes.size()] + "\n";
+        client.sentAt = chrono::steady_clock::now();
+        client.waiting = send(client.fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+        if (!client.waiting) ++failedSends;
+    };
 
-                    switch(choice) {
-                        case 1: timeMultiplier = 0; cout << YELLOW << "Time paused.\n" << RESET; break;
-                        case 2: timeMultiplier = 2; cout << YELLOW << "Time set to 2x speed.\n" << RESET; break;
-                        case 3: timeMultiplier = 5; cout << YELLOW << "Time set to 5x speed.\n" << RESET; break;
-                        case 4: cout << RED << "🔙 Rewind not implemented yet!\n" << RESET; break;
-                        default: cout << RED << "Invalid time control option!\n" << RESET; break;
-                    }
-                    break;
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+    for (Client& client : clients) sendRequest(client);
+    size_t waiting = count_if(clients.begin(), clients.end(), [](const Client& c) { return c.waiting; });
+    vector<epoll_event> events(256);
+    while (waiting > 0 && chrono::steady_clock::now() < deadline + chrono::seconds(5)) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 100);
+        for (int i = 0; i < ready; ++i) {
+            Client& client = clients[events[i].data.u64];
+            ssize_t got;
+            while ((got = recv(client.fd, buffer, sizeof(buffer), 0)) > 0) client.in.append(buffer, got);
+            size_t newline;
+            while (client.waiting && (newline = client.in.find('\n')) != string::npos) {
+                auto now = chrono::steady_clock::now();
+                latencies.push_back(chrono::duration<double, milli>(now - client.sentAt).count());
+                if (client.in.compare(0, 7, "ERR|unr") != 0 && client.in.compare(0, 2, "OK") != 0) ++errors; // Unreachable is an answer
+                client.in.erase(0, newline + 1);
+                client.waiting = false;
+                --waiting;
+                if (now < deadline) {
+                    sendRequest(client);
+                    if (client.waiting) ++waiting;
                 }
-                case 14: exportToCSV(); break; // Export Data
-                case 15: runTutorial(); break;  // Run Tutorial
-                default: cout << RED << "Invalid Option! Please select a number from the menu.\n" << RESET;
             }
-            // Pause before showing the menu again to allow user to read output
-            cout << "\n" << BOLD << "Press Enter to continue..." << RESET;
-            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear input buffer and wait for Enter
+            if (got == 0 && client.waiting) { client.waiting = false; --waiting; ++errors; } // Server closed the connection
         }
     }
-private:
-    // Adds a set of predefined roads to the graph for initial setup
-    void addDefaultRoads() {
-        // Highway system
-        addRoad("Downtown", "Midtown", 300, 60, "Highway");
-        addRoad("Midtown", "Uptown", 400, 80, "Highway");
-        addRoad("Downtown", "Airport", 500, 120, "Highway");
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (Client& client : clients) close(client.fd);
+    close(epollFd);
 
-        // City streets
-        addRoad("Downtown", "Market St", 120, 30, "General");
-        addRoad("Market St", "City Hall", 90, 20, "General");
-        addRoad("City Hall", "Uptown", 180, 40, "General");
-        addRoad("Downtown", "Residential Area", 150, 25, "General");
-        addRoad("Market St", "Industrial Zone", 250, 50, "General");
+    auto percentile = [&](double p) {
+        if (latencies.empty()) return 0.0;
+        size_t rank = min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+        nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+        return latencies[rank];
+    };
+    cout << CYAN << "\n=== Load Generator Results ===\n" << RESET
+         << "Target: " << address << " | Connections: " << clients.size() << " | Duration: " << fixed << setprecision(2) << elapsed << "s\n"
+         << "Requests completed: " << latencies.size() << " | Errors: " << errors << " | Failed sends: " << failedSends << "\n"
+         << "Throughput: " << setprecision(0) << latencies.size() / max(elapsed, 1e-9) << " req/s\n"
+         << setprecision(3) << "Latency p50: " << percentile(0.50) << " ms | p90: " << percentile(0.90)
+         << " ms | p99: " << percentile(0.99) << " ms | max: " << percentile(1.0) << " ms\n";
+}
+#endif
 
-        // Special routes
-        addRoad("Midtown", "Bike Trail", 150, 10, "Bike Lane"); // Renamed for clarity
-        addRoad("City Hall", "Bus Terminal", 200, 30, "Bus Lane");
-        addRoad("Airport", "Emergency Hospital", 100, 10, "Emergency"); // New emergency specific road
-        addRoad("Uptown", "Suburban Tunnel", 350, 70, "Tunnel");
-        addRoad("Residential Area", "Central Bridge", 200, 40, "Bridge");
+// ================ SHARDED SIMULATION ================
+// Runs a large region as one worker process per shard of a graph partition. A worker holds its
+// shard's roads, simulates their traffic and answers routing requests inside the shard over a
+// Unix socket pair. The coordinator keeps only the roads between shards (cut roads) and routes
+// across shards on an overlay graph of boundary nodes (nodes with a cut road): each shard
+// contributes a boundary-to-boundary time table, and the cut roads join the tables. Worker
+// protocol, one line each way, nodes by name, times in seconds with -1 for unreachable:
+//   BOUNDARY|<vehicle>            -> OK|<b0->b0>,<b0->b1>,...;<b1->b0>,...   (shard's boundary order)
+//   FROM|<vehicle>|<node>         -> OK|<node->b0>,<node->b1>,...
+//   TO|<vehicle>|<node>           -> OK|<b0->node>,<b1->node>,...
+//   PATH|<vehicle>|<from>|<to>    -> OK|<seconds>|<node>|<node>|...
+//   TICK|<seed>                   -> OK|<roads whose congestion changed>
+//   WEATHER|<0-4>                 -> OK
+//   STATS                         -> OK|<requests>|<busy microseconds>
+//   QUIT
+// Workers start from the graph's state at start(); incidents and closures raised later only
+// reach the coordinator's cut roads.
+#ifdef __linux__
+bool writeLine(int fd, const string& text) {
+    string line = text + "\n";
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t wrote = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (wrote < 0 && errno == EINTR) continue;
+        if (wrote <= 0) return false;
+        sent += wrote;
+    }
+    return true;
+}
 
-        cout << CYAN << "Default roads loaded.\n" << RESET;
+// Next line from fd into 'line', keeping what was read past it in 'buffer'; false at end of stream.
+bool readLine(int fd, string& buffer, string& line) {
+    size_t newline;
+    while ((newline = buffer.find('\n')) == string::npos) {
+        char chunk[16384];
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        buffer.append(chunk, got);
     }
+    line = buffer.substr(0, newline);
+    buffer.erase(0, newline + 1);
+    return true;
+}
 
-    // Applies weather effects to road weights based on current weather conditions.
-    // IMPORTANT: This now correctly uses the 'baseEdges' to get the original weight
-    // and then applies the weather multiplier, preventing compounding effects.
-    void applyWeatherEffects() {
-        double weatherMult = getWeatherMultiplier();
-        for (auto& nodePair : adjList) {
-            for (auto& edge : nodePair.second) {
-                // Find the original base weight for this specific edge from the baseEdges map
-                double originalBaseWeight = 0;
-                // Memory Safety: Check if key exists before using .at()
-                if (baseEdges.count({nodePair.first, edge.destination})) {
-                    originalBaseWeight = baseEdges.at({nodePair.first, edge.destination}).weight;
-                } else if (baseEdges.count({edge.destination, nodePair.first})) { // Check reverse direction if needed
-                    originalBaseWeight = baseEdges.at({edge.destination, nodePair.first}).weight;
+class ShardCoordinator {
+public:
+    explicit ShardCoordinator(Graph& g) : master(g) {}
+    ~ShardCoordinator() { stop(); }
+
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+    // Partitions the graph and forks one worker per shard; false if a worker could not be started.
+    bool start(int shardCount) {
+        stop();
+        master.applyFeedEvents();
+        master.refreshIncidentClosures();
+        master.applyWeatherEffects();
+        weatherSent = currentWeather;
+
+        const int n = static_cast<int>(master.nodeNames.size());
+        part = master.partitionNodes(shardCount);
+        shards.assign(n ? *max_element(part.begin(), part.end()) + 1 : 0, Shard());
+        overlayIndex.assign(n, -1);
+        boundarySlot.assign(n, -1);
+        overlayNodes.clear();
+        cutRoads.clear();
+        for (int e = 0; e < master.edgeCount; ++e) {
+            int u = master.edgeSlots[e].first, v = master.edgeById(e).to;
+            if (part[u] != part[v]) {
+                cutRoads.push_back(e);
+                overlayIndex[u] = 0; // Boundary node; numbered below in id order
+            } else if (e % 2 == 0) {
+                ++shards[part[u]].roads;
+            }
+        }
+        for (int v = 0; v < n; ++v) {
+            Shard& shard = shards[part[v]];
+            ++shard.nodes;
+            if (overlayIndex[v] < 0) continue;
+            overlayIndex[v] = static_cast<int>(overlayNodes.size());
+            overlayNodes.push_back(v);
+            boundarySlot[v] = static_cast<int>(shard.boundary.size());
+            shard.boundary.push_back(v);
+        }
+        cutOut.assign(overlayNodes.size(), vector<int>());
+        for (int e : cutRoads) cutOut[overlayIndex[master.edgeSlots[e].first]].push_back(e);
+
+        cout.flush(); // Workers must not inherit unwritten output
+        for (size_t s = 0; s < shards.size(); ++s) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) { stop(); return false; }
+            pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                stop();
+                return false;
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                for (size_t t = 0; t < s; ++t) close(shards[t].fd); // So workers see EOF when the coordinator goes
+                runWorker(static_cast<int>(s), fds[1]);
+                _exit(0);
+            }
+            close(fds[1]);
+            shards[s].fd = fds[0];
+            shards[s].pid = pid;
+        }
+        return true;
+    }
+
+    // Asks every worker to exit and reaps it.
+    void stop() {
+        for (Shard& shard : shards) {
+            if (shard.fd < 0) continue;
+            writeLine(shard.fd, "QUIT");
+            close(shard.fd);
+            waitpid(shard.pid, nullptr, 0);
+            shard.fd = -1;
+        }
+        shards.clear();
+        tables.clear();
+    }
+
+    // Fastest route for a vehicle (query server naming, e.g. "car" or "ambulance!"), with the node
+    // names left in 'path'; -1 if the route, a node or the vehicle does not exist.
+    int route(const string& vehicleName, const string& from, const string& to, vector<string>& path) {
+        VehicleType type;
+        bool emergency;
+        auto src = master.nodeIds.find(from), dest = master.nodeIds.find(to);
+        if (shards.empty() || !parseVehicleName(vehicleName, type, emergency)
+            || src == master.nodeIds.end() || dest == master.nodeIds.end()) return -1;
+        syncConditions();
+        RuntimeVehiclePolicy policy{Vehicle(type, emergency)};
+        const vector<vector<int>>& table = boundaryTables(vehicleName);
+        int a = part[src->second], b = part[dest->second];
+
+        // Both ends at once: times to the source shard's boundary, from the destination shard's
+        // boundary, and the route that stays inside the shard when both ends share one
+        request(shards[a], "FROM|" + vehicleName + "|" + from);
+        request(shards[b], "TO|" + vehicleName + "|" + to);
+        if (a == b) request(shards[a], "PATH|" + vehicleName + "|" + from + "|" + to);
+        vector<int> fromBoundary = distances(reply(shards[a])), toBoundary = distances(reply(shards[b]));
+        vector<string> local;
+        int best = ROUTE_UNREACHABLE, exit = -1;
+        if (a == b) {
+            local = splitFields(reply(shards[a]), '|');
+            if (local[0] == "OK") best = atoi(local[1].c_str());
+        }
+
+        // Dijkstra over the overlay, seeded with the source shard's boundary
+        const int m = static_cast<int>(overlayNodes.size());
+        vector<int> dist(m, ROUTE_UNREACHABLE), parent(m, -1), viaRoad(m, -1);
+        BinaryHeapQueue& queue = overlayQueue;
+        queue.reset(m);
+        for (size_t i = 0; i < shards[a].boundary.size(); ++i) {
+            if (i >= fromBoundary.size() || fromBoundary[i] < 0) continue;
+            int x = overlayIndex[shards[a].boundary[i]];
+            dist[x] = fromBoundary[i];
+            queue.push(dist[x], x);
+        }
+        while (!queue.empty()) {
+            pair<int, int> current = queue.pop();
+            int x = current.second, d = current.first;
+            if (d > dist[x]) continue;
+            if (d >= best) break; // Nothing left can beat the best complete route
+            int v = overlayNodes[x], s = part[v], i = boundarySlot[v];
+            if (s == b && i < static_cast<int>(toBoundary.size()) && toBoundary[i] >= 0 && d + toBoundary[i] < best) {
+                best = d + toBoundary[i];
+                exit = x;
+            }
+            auto relax = [&](int y, int cost, int road) {
+                if (d + cost < dist[y]) {
+                    dist[y] = d + cost;
+                    parent[y] = x;
+                    viaRoad[y] = road;
+                    queue.push(dist[y], y);
                 }
+            };
+            const vector<int>& row = table[s];
+            size_t width = shards[s].boundary.size();
+            for (size_t j = 0; j < width; ++j) {
+                int cost = row[i * width + j];
+                if (cost >= 0 && j != static_cast<size_t>(i)) relax(overlayIndex[shards[s].boundary[j]], cost, -1);
+            }
+            for (int e : cutOut[x]) {
+                int cost = master.vehicleCost(master.edgeById(e), policy);
+                if (cost != ROUTE_UNREACHABLE) relax(overlayIndex[master.edgeById(e).to], cost, e);
+            }
+        }
 
-                // Fallback: If for some reason the original base weight isn't found (shouldn't happen if all roads
-                // are added via addRoad), use the current edge's weight as a temporary base.
-                if (originalBaseWeight == 0) originalBaseWeight = edge.weight;
+        path.clear();
+        if (best == ROUTE_UNREACHABLE) return -1;
+        if (exit < 0) { // The route inside the shard won
+            path.assign(local.begin() + 2, local.end());
+            ++localRoutes;
+            return best;
+        }
 
-                // Apply weather multiplier to the original base weight and update the edge's current weight
-                edge.weight = originalBaseWeight / weatherMult;
+        // Expand the overlay route: shard-internal legs are asked of their workers, cut roads are
+        // taken as they are.
+        vector<int> hops;
+        for (int x = exit; x >= 0; x = parent[x]) hops.push_back(x);
+        reverse(hops.begin(), hops.end());
+        vector<pair<int, string>> legs; // {shard, PATH request}, or {-1, node name} for a cut road
+        bool crossed = false;
+        auto leg = [&](int s, const string& u, const string& v) {
+            if (u != v) legs.push_back({s, "PATH|" + vehicleName + "|" + u + "|" + v});
+        };
+        leg(a, from, master.nodeNames[overlayNodes[hops[0]]]);
+        for (size_t k = 1; k < hops.size(); ++k) {
+            int u = overlayNodes[hops[k - 1]], v = overlayNodes[hops[k]];
+            if (viaRoad[hops[k]] >= 0) {
+                legs.push_back({-1, master.nodeNames[v]});
+                ++shards[part[u]].handoffsOut;
+                ++shards[part[v]].handoffsIn;
+                ++cutRoadsTraversed;
+                crossed = true;
+            } else {
+                leg(part[u], master.nodeNames[u], master.nodeNames[v]);
             }
         }
+        leg(b, master.nodeNames[overlayNodes[exit]], to);
+        for (const auto& l : legs) if (l.first >= 0) request(shards[l.first], l.second);
+        path.push_back(from);
+        for (const auto& l : legs) {
+            if (l.first < 0) { path.push_back(l.second); continue; }
+            vector<string> fields = splitFields(reply(shards[l.first]), '|');
+            if (fields[0] != "OK") return -1; // A worker lost a leg it just priced: conditions changed under us
+            path.insert(path.end(), fields.begin() + 3, fields.end()); // Skip OK, time and the joint node
+        }
+        ++(crossed ? crossShardRoutes : localRoutes);
+        return best;
     }
 
-    void simulateTimeDelay(int seconds) {
-        cout << CYAN << "\nSimulating journey (" << seconds << " seconds)...\n" << RESET;
-        progressBar(seconds);
+    // One simulation step everywhere: each worker moves its shard's traffic and the coordinator
+    // moves the cut roads'. Boundary tables are rebuilt on the next route.
+    void tick() {
+        ++ticks;
+        for (size_t s = 0; s < shards.size(); ++s) request(shards[s], "TICK|" + to_string(ticks * 7919 + s));
+        master.driftCongestion(cutRoads, static_cast<uint32_t>(ticks * 7919 + shards.size()));
+        for (Shard& shard : shards) shard.changed += atoi(splitFields(reply(shard), '|').back().c_str());
+        tables.clear();
     }
 
-    // Unit Test Scaffolding
-    #ifdef TESTING
-    public: // Making public for external test access
-    static void runTests() {
-        Graph testGraph;
-        cout << GREEN << "\n=== Running Unit Tests ===\n" << RESET;
+    void showReport() {
+        for (Shard& shard : shards) request(shard, "STATS");
+        for (Shard& shard : shards) {
+            vector<string> fields = splitFields(reply(shard), '|');
+            if (fields.size() == 3) shard.busyMicros = strtoull(fields[2].c_str(), nullptr, 10);
+        }
+        int roads = 0;
+        for (const Shard& shard : shards) roads += shard.roads;
+        roads += static_cast<int>(cutRoads.size()) / 2;
+        cout << CYAN << "\n=== SHARD COORDINATOR REPORT ===\n" << RESET
+             << "Shards: " << shards.size() << " | nodes: " << part.size() << " | roads: " << roads
+             << " | cut roads: " << cutRoads.size() / 2 << " (" << fixed << setprecision(1)
+             << (roads ? 50.0 * cutRoads.size() / roads : 0.0) << "%) | overlay nodes: " << overlayNodes.size() << "\n"
+             << left << setw(7) << "Shard" << setw(8) << "Nodes" << setw(8) << "Roads" << setw(10) << "Boundary"
+             << setw(10) << "Requests" << setw(10) << "Busy ms" << setw(10) << "Sent KB" << setw(10) << "Recv KB"
+             << setw(10) << "Hand-in" << setw(10) << "Hand-out" << "Drifted\n";
+        for (size_t s = 0; s < shards.size(); ++s) {
+            const Shard& shard = shards[s];
+            cout << setw(7) << s << setw(8) << shard.nodes << setw(8) << shard.roads << setw(10) << shard.boundary.size()
+                 << setw(10) << shard.requests << setw(10) << shard.busyMicros / 1000.0 << setw(10) << shard.bytesSent / 1024.0
+                 << setw(10) << shard.bytesReceived / 1024.0 << setw(10) << shard.handoffsIn << setw(10) << shard.handoffsOut
+                 << shard.changed << "\n";
+        }
+        cout << right << "Routes: " << localRoutes << " within one shard | " << crossShardRoutes << " across shards ("
+             << cutRoadsTraversed << " cut road traversals) | ticks: " << ticks << "\n";
+    }
 
-        // Test 1: Add road and basic shortest path
-        testGraph.addRoad("TestA", "TestB", 100, 0);
-        Vehicle testCar(CAR);
-        testGraph.shortestPath("TestA", "TestB", testCar);
+private:
+    struct Shard {
+        pid_t pid = -1;
+        int fd = -1;
+        string inbox;            // Bytes read past the last reply
+        vector<int> boundary;    // Master ids of the boundary nodes, in id order
+        int nodes = 0, roads = 0;
+        uint64_t requests = 0, bytesSent = 0, bytesReceived = 0, busyMicros = 0;
+        uint64_t handoffsIn = 0, handoffsOut = 0, changed = 0;
+    };
 
-        // Test 2: Edge case - same source and destination
-        testGraph.shortestPath("TestA", "TestA", testCar);
+    Graph& master;
+    vector<int> part;                // Shard of each master node id
+    vector<Shard> shards;
+    vector<int> overlayNodes;        // Master id of each overlay (boundary) node
+    vector<int> overlayIndex;        // Overlay index of each master node id; -1 inside a shard
+    vector<int> boundarySlot;        // Position of a boundary node in its shard's boundary list
+    vector<int> cutRoads;            // Master edge ids between shards (both directions)
+    vector<vector<int>> cutOut;      // Cut roads leaving each overlay node
+    map<string, vector<vector<int>>> tables; // Per vehicle, per shard: row-major boundary time table
+    BinaryHeapQueue overlayQueue;
+    WeatherType weatherSent = SUNNY;
+    uint64_t ticks = 0, localRoutes = 0, crossShardRoutes = 0, cutRoadsTraversed = 0;
 
-        // Test 3: Edge case - non-existent node
-        testGraph.shortestPath("TestA", "NonExistent", testCar);
+    void request(Shard& shard, const string& text) {
+        ++shard.requests;
+        shard.bytesSent += text.size() + 1;
+        if (!writeLine(shard.fd, text)) cout << RED << "Error: Shard worker " << shard.pid << " is gone.\n" << RESET;
+    }
 
-        // Test 4: Check if Singleton IncidentMonitor is working
-        IncidentMonitor::getInstance().generateIncident();
-        IncidentMonitor::getInstance().showActiveIncidents();
+    string reply(Shard& shard) {
+        string line;
+        if (!readLine(shard.fd, shard.inbox, line)) return "ERR|worker gone";
+        shard.bytesReceived += line.size() + 1;
+        return line;
+    }
 
-        // Test 5: Strategy pattern
-        testGraph.FastestRoute().calculate(testGraph, "TestA", "TestB");
-        testGraph.EmergencyRoute().calculate(testGraph, "TestA", "TestB");
+    static vector<int> distances(const string& reply) {
+        vector<int> result;
+        if (reply.compare(0, 3, "OK|") != 0) return result;
+        for (const string& field : splitFields(reply.substr(3), ',')) result.push_back(field.empty() ? -1 : atoi(field.c_str()));
+        return result;
+    }
+
+    // Boundary time tables for a vehicle, fetched from all workers in parallel on first use.
+    const vector<vector<int>>& boundaryTables(const string& vehicleName) {
+        auto it = tables.find(vehicleName);
+        if (it != tables.end()) return it->second;
+        vector<vector<int>>& table = tables[vehicleName];
+        for (Shard& shard : shards) request(shard, "BOUNDARY|" + vehicleName);
+        for (size_t s = 0; s < shards.size(); ++s) {
+            string text = reply(shards[s]);
+            size_t width = shards[s].boundary.size();
+            replace(text.begin(), text.end(), ';', ',');
+            vector<int> row = distances(text);
+            row.resize(width * width, -1);
+            table.push_back(move(row));
+        }
+        return table;
+    }
 
-        cout << GREEN << "\n=== Unit tests passed! ===\n" << RESET;
+    // Passes weather changes to the workers and brings the cut roads up to date.
+    void syncConditions() {
+        WeatherType weather = currentWeather;
+        if (weather != weatherSent) {
+            for (Shard& shard : shards) request(shard, "WEATHER|" + to_string(static_cast<int>(weather)));
+            for (Shard& shard : shards) reply(shard);
+            weatherSent = weather;
+            tables.clear();
+        }
+        master.refreshIncidentClosures();
+        master.applyWeatherEffects();
+    }
+
+    void runWorker(int s, int fd) {
+        Graph shard;
+        shard.loadShard(master, part, s);
+        vector<int> boundary;
+        for (int v : shards[s].boundary) boundary.push_back(shard.nodeIds.at(master.nodeNames[v]));
+        string buffer, line;
+        uint64_t requests = 0;
+        chrono::nanoseconds busy(0);
+        while (readLine(fd, buffer, line) && line != "QUIT") {
+            auto begin = chrono::steady_clock::now();
+            string answer = line == "STATS"
+                ? "OK|" + to_string(requests) + "|" + to_string(chrono::duration_cast<chrono::microseconds>(busy).count())
+                : shard.answerShardRequest(line, boundary);
+            if (line != "STATS") {
+                ++requests;
+                busy += chrono::steady_clock::now() - begin;
+            }
+            if (!writeLine(fd, answer)) break;
+        }
+        close(fd);
     }
-    #endif
 };
+#endif
+
+#if defined(TESTING) && defined(__linux__)
+// Round trip through the query server on a Unix socket; runs after Graph::runTests(). Returns the failure count.
+int runServerTests() {
+    Graph serverGraph;
+    serverGraph.loadMap(0);
+    Graph::Route expected;
+    serverGraph.computeRoute("Downtown", "Airport", Vehicle(CAR), expected);
+    string path = "/tmp/traffic_query_test_" + to_string(getpid()) + ".sock";
+    QueryServer server(serverGraph);
+    if (!server.open("unix:" + path)) {
+        cout << RED << "Test 15 failed: query server could not listen on " << path << ".\n" << RESET;
+        return 1;
+    }
+    thread loop([&] { server.run(2); });
+    int sock = openServerSocket("unix:" + path, false);
+    string requests = "PING\nROUTE|car|Downtown|Airport\nMATRIX|car|Downtown;Uptown|Airport;Downtown\nROUTE|tank|Downtown|Airport\n";
+    string replies;
+    if (sock >= 0 && send(sock, requests.data(), requests.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(requests.size())) {
+        char buffer[4096];
+        while (count(replies.begin(), replies.end(), '\n') < 4) {
+            ssize_t got = recv(sock, buffer, sizeof(buffer), 0);
+            if (got <= 0) break;
+            replies.append(buffer, got);
+        }
+    }
+    if (sock >= 0) close(sock);
+    server.stop();
+    loop.join();
+    vector<string> lines = splitFields(replies, '\n');
+    bool ok = lines.size() >= 4 && lines[0] == "OK|PONG"
+        && lines[1].compare(0, 4 + to_string(expected.totalTime).size(), "OK|" + to_string(expected.totalTime) + "|") == 0
+        && lines[2].compare(0, 3, "OK|") == 0 && lines[2].find(";") != string::npos
+        && lines[3].compare(0, 4, "ERR|") == 0;
+    if (!ok) cout << RED << "Test 15 failed: query server replies were wrong:\n" << replies << RESET;
+    return ok ? 0 : 1;
+}
+
+// Sharded routes against the single-process search on a grid city split into three workers.
+// Returns the failure count.
+int runShardTests() {
+    Graph city;
+    city.loadMap(12);
+    vector<string> names = city.makeSnapshot()->nodes->names;
+    ShardCoordinator coordinator(city);
+    if (!coordinator.start(3)) {
+        cout << RED << "Test 17 failed: shard workers did not start.\n" << RESET;
+        return 1;
+    }
+    const char* vehicles[] = {"car", "bike", "ambulance!"};
+    const VehicleType types[] = {CAR, BIKE, AMBULANCE};
+    vector<string> path;
+    for (size_t i = 0; i < names.size(); i += 7) {
+        for (size_t j = 0; j < names.size(); j += 5) {
+            for (int k = 0; k < 3; ++k) {
+                Graph::Route expected;
+                bool found = city.computeRoute(names[i], names[j], Vehicle(types[k], k == 2), expected);
+                int time = coordinator.route(vehicles[k], names[i], names[j], path);
+                if ((found ? expected.totalTime : -1) != time || (found && (path.front() != names[i] || path.back() != names[j]))) {
+                    cout << RED << "Test 17 failed: sharded " << vehicles[k] << " route " << names[i] << " -> " << names[j]
+                         << " took " << time << "s, expected " << (found ? expected.totalTime : -1) << "s.\n" << RESET;
+                    return 1;
+                }
+            }
+        }
+    }
+    coordinator.tick();
+    if (coordinator.route("car", names.front(), names.back(), path) < 0) {
+        cout << RED << "Test 17 failed: no sharded route after a tick.\n" << RESET;
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef __linux__
+// Non-interactive modes:
+//   --serve [address] [grid side]          routing query server (default 127.0.0.1:7878, default roads)
+//   --loadgen [address] [connections] [seconds]
+//   --shards [count] [grid side] [routes]   sharded simulation with random routes (default 4, 60, 400)
+//   --montecarlo [runs] [threads] [seed] [grid side]   travel-time percentiles (default 2000, all cores, 42)
+int runCommandLine(Graph& sim, const vector<string>& args) {
+    string address = args.size() > 1 ? args[1] : "127.0.0.1:7878";
+    if (args[0] == "--serve") {
+        raiseFileLimit();
+        sim.loadMap(args.size() > 2 ? atoi(args[2].c_str()) : 0);
+        QueryServer server(sim);
+        if (!server.open(address)) {
+            cout << RED << "Error: Could not listen on " << address << " (TCP addresses must be on localhost).\n" << RESET;
+            return 1;
+        }
+        signal(SIGINT, [](int) { serverInterrupted = 1; });
+        signal(SIGTERM, [](int) { serverInterrupted = 1; });
+        unsigned workers = max(1u, thread::hardware_concurrency());
+        cout << GREEN << "Routing query server listening on " << address << " with " << workers << " workers (Ctrl+C to stop).\n" << RESET;
+        server.run(workers);
+        server.showStatus();
+        return 0;
+    }
+    if (args[0] == "--loadgen") {
+        int connections = args.size() > 2 ? max(1, atoi(args[2].c_str())) : 64;
+        double seconds = args.size() > 3 ? max(0.1, atof(args[3].c_str())) : 5.0;
+        runLoadGenerator(address, connections, seconds);
+        return 0;
+    }
+    if (args[0] == "--shards") {
+        int count = args.size() > 1 ? max(1, atoi(args[1].c_str())) : 4;
+        int side = args.size() > 2 ? atoi(args[2].c_str()) : 60;
+        int routes = args.size() > 3 ? max(1, atoi(args[3].c_str())) : 400;
+        sim.loadMap(side);
+        ShardCoordinator coordinator(sim);
+        if (!coordinator.start(count)) {
+            cout << RED << "Error: Could not start the shard workers.\n" << RESET;
+            return 1;
+        }
+        cout << GREEN << "Started " << count << " shard workers; routing " << routes << " random car trips, one tick every 50.\n" << RESET;
+        vector<string> names = sim.makeSnapshot()->nodes->names;
+        mt19937 rng(7);
+        int checked = 0, mismatches = 0, unreachable = 0;
+        vector<string> path;
+        auto begin = chrono::steady_clock::now();
+        for (int q = 0; q < routes; ++q) {
+            if (q > 0 && q % 50 == 0) coordinator.tick();
+            const string& from = names[rng() % names.size()];
+            const string& to = names[rng() % names.size()];
+            int time = coordinator.route("car", from, to, path);
+            if (time < 0) ++unreachable;
+            if (q < 50) { // Before the first tick the shards still match the single-process graph
+                Graph::Route expected;
+                bool found = sim.computeRoute(from, to, Vehicle(CAR), expected);
+                ++checked;
+                if ((found ? expected.totalTime : -1) != time) ++mismatches;
+            }
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        cout << "Routed " << routes << " trips in " << fixed << setprecision(1) << ms << " ms (" << unreachable << " unreachable); "
+             << (mismatches ? RED : GREEN) << mismatches << " of " << checked << " differ from the single-process search\n" << RESET;
+        coordinator.showReport();
+        return mismatches ? 1 : 0;
+    }
+    if (args[0] == "--montecarlo") {
+        int runs = args.size() > 1 ? max(1, atoi(args[1].c_str())) : 2000;
+        unsigned threads = args.size() > 2 ? max(1, atoi(args[2].c_str())) : max(1u, thread::hardware_concurrency());
+        uint64_t seed = args.size() > 3 ? strtoull(args[3].c_str(), nullptr, 10) : 42;
+        int side = args.size() > 4 ? atoi(args[4].c_str()) : 0;
+        sim.loadMap(side);
+        DemandMatrix demand; // Sample demand on the default roads; ten corner-to-corner style pairs on a grid
+        if (side > 1) {
+            mt19937 rng(static_cast<unsigned>(seed));
+            vector<string> names = sim.makeSnapshot()->nodes->names;
+            while (demand.trips.size() < 10) demand.add(names[rng() % names.size()], names[rng() % names.size()], 100);
+        }
+        auto begin = chrono::steady_clock::now();
+        vector<MonteCarloRunner::Distribution> result = sim.runScenarios(demand, Vehicle(CAR), runs, seed, threads);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        MonteCarloRunner::showReport(result);
+        cout << runs << " runs on " << threads << " threads in " << fixed << setprecision(1) << ms << " ms ("
+             << setprecision(0) << runs / (ms / 1000.0) << " runs/s), seed " << seed << "\n";
+        return 0;
+    }
+    cout << RED << "Unknown option " << args[0] << ". Use [--seed n] followed by --serve [address] [grid side], --loadgen [address] [connections] [seconds],"
+         << " --shards [count] [grid side] [routes] or --montecarlo [runs] [threads] [seed] [grid side].\n" << RESET;
+    return 1;
+}
+#endif
 
-int main() {
+int main(int argc, char* argv[]) {
 #ifdef _WIN32 // Conditionally compile SetConsoleOutputCP for Windows
     // Set console output code page to UTF-8 (65001) for proper emoji display.
     // This is crucial for Windows consoles to show emojis correctly.
     SetConsoleOutputCP(65001);
 #endif
-    // Seed the random number generator using current time for varied results
-    srand(static_cast<unsigned int>(time(nullptr)));
+    // Seed the simulation's random streams using current time for varied results, or with
+    // --seed <n> so a session's weather and incidents can be replayed
+    vector<string> args(argv + 1, argv + argc);
+    simulationSeed = static_cast<uint64_t>(time(nullptr));
+    if (args.size() >= 2 && args[0] == "--seed") {
+        simulationSeed = strtoull(args[1].c_str(), nullptr, 10);
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    useRandomStream(MENU_STREAM);
 
     // Multithreading for Weather: Start weather update in a separate thread
     std::thread weatherThread([](){
+        useRandomStream(WEATHER_STREAM);
         while (true) {
-            sleep_seconds(WEATHER_UPDATE_INTERVAL / max(1, timeMultiplier)); // Update based on global constant and time multiplier
+            sleep_seconds(WEATHER_UPDATE_INTERVAL / max(1, timeMultiplier.load())); // Update based on global constant and time multiplier
             updateWeather();
         }
     });
@@ -990,10 +6530,25 @@ int main() {
 
     Graph sim; // Create an instance of the Graph class
 
-    // Unit Test Execution (if TESTING macro is defined during compilation)
+    // Unit Test / Benchmark Execution (if TESTING or BENCHMARK is defined during compilation)
     #ifdef TESTING
-    Graph::runTests();
+    int failures = Graph::runTests();
+#ifdef __linux__
+    failures += runServerTests();
+    failures += runShardTests();
+#endif
+    // After every suite, so no failure follows the verdict
+    if (failures > 0) {
+        cout << RED << "\n=== " << failures << " unit test check(s) failed ===\n" << RESET;
+        return 1;
+    }
+    cout << GREEN << "\n=== Unit tests passed! ===\n" << RESET;
+    #elif defined(BENCHMARK)
+    Graph::runBenchmarks();
     #else
+#ifdef __linux__
+    if (!args.empty()) return runCommandLine(sim, args);
+#endif
     sim.mainMenu(); // Start the main application menu only if not testing
     #endif
 